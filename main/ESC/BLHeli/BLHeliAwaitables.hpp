@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ESC/BLHeli/BLHeliControlSchemeUART.hpp"
+#include "ESC/BLHeli/BLHeliESC.hpp"
+#include "ESC/ESCAwaitables.hpp"
+
+#include <optional>
+
+namespace pcp {
+    // Resumes with false if the command can't be sent, straight away if that's known before it's queued.
+    inline auto sendCommandAsync(BLHeliESC& esc, ESCCommand command, CoroutineExecutor& executor) {
+        return awaitCompletion<bool>(executor, [&esc, command](auto* awaitable) {
+            if (!esc.sendCommand(command, [awaitable](bool sent) { awaitable->complete(sent); })) {
+                awaitable->complete(false);
+            }
+        });
+    }
+
+    inline auto enterProgrammingModeAsync(BLHeliESC& esc, CoroutineExecutor& executor) {
+        return awaitCompletion<std::optional<BLHeliESCConfig>>(executor, [&esc](auto* awaitable) {
+            esc.enterProgrammingMode([awaitable](std::optional<BLHeliESCConfig> config) { awaitable->complete(std::move(config)); });
+        });
+    }
+
+    inline auto connectAsync(BLHeliControlSchemeUART& scheme, CoroutineExecutor& executor) {
+        return awaitCompletion<bool>(executor, [&scheme](auto* awaitable) { scheme.connect([awaitable](bool success) { awaitable->complete(success); }); });
+    }
+}  // namespace pcp
@@ -0,0 +1,121 @@
+#include "ESC/BLHeli/BLHeliCalibrationCache.hpp"
+
+#include "Log.hpp"
+
+#include "nvs.h"
+
+#include <cstdio>
+
+namespace pcp {
+    static constexpr const char* kNVSNamespace = "pcp_calib";
+    static constexpr const char* kLastSignatureKey = "last_sig";
+
+    // As stored, in microseconds and milliseconds.  Entries of any other size are ignored, so the ESC is
+    // read again when this changes.
+    struct StoredCalibration {
+        uint16_t minUs;
+        uint16_t maxUs;
+        uint16_t coldStepMs;
+        uint16_t warmHoldMs;
+        uint32_t warmWindowMs;
+    };
+
+    // NVS keys are limited to 15 characters, "esc_" and four hex digits fits.
+    static std::array<char, 9> calibrationKey(const std::array<uint8_t, 2>& signature) {
+        std::array<char, 9> key{};
+        snprintf(key.data(), key.size(), "esc_%02x%02x", signature[0], signature[1]);
+        return key;
+    }
+
+    static std::optional<BLHeliCalibration> readCalibration(nvs_handle_t handle, const std::array<uint8_t, 2>& signature) {
+        StoredCalibration stored;
+        size_t length = sizeof(stored);
+        esp_err_t err = nvs_get_blob(handle, calibrationKey(signature).data(), &stored, &length);
+        if (err != ESP_OK || length != sizeof(stored)) {
+            return std::optional<BLHeliCalibration>();
+        }
+
+        const BLHeliCalibration calibration = {
+            .throttleEndpoints = {.min = UsTime(stored.minUs), .max = UsTime(stored.maxUs)},
+            .armProfile = {.coldStep = MsTime(stored.coldStepMs), .warmHold = MsTime(stored.warmHoldMs), .warmWindow = MsTime(stored.warmWindowMs)},
+            .signature = signature,
+        };
+        const ESCThrottleEndpoints& endpoints = calibration.throttleEndpoints;
+        if (endpoints.min < 1000_us || endpoints.max <= endpoints.min || endpoints.max > 2100_us) {
+            PCP_LOGW("Ignoring implausible cached throttle endpoints %u-%uus", stored.minUs, stored.maxUs);
+            return std::optional<BLHeliCalibration>();
+        }
+        return calibration;
+    }
+
+    std::optional<BLHeliCalibration> cachedCalibrationForLastESC(void) {
+        nvs_handle_t handle;
+        if (nvs_open(kNVSNamespace, NVS_READONLY, &handle) != ESP_OK) {
+            return std::optional<BLHeliCalibration>();
+        }
+
+        std::optional<BLHeliCalibration> calibration;
+        std::array<uint8_t, 2> signature;
+        size_t length = signature.size();
+        if (nvs_get_blob(handle, kLastSignatureKey, signature.data(), &length) == ESP_OK && length == signature.size()) {
+            calibration = readCalibration(handle, signature);
+        }
+        nvs_close(handle);
+        return calibration;
+    }
+
+    void cacheCalibration(const BLHeliESCConfig& config) {
+        const ESCThrottleEndpoints endpoints = config.throttleEndpoints();
+        const ESCArmProfile armProfile = config.armProfile();
+        const std::array<uint8_t, 2>& signature = config.deviceSignature();
+        const StoredCalibration stored = {
+            .minUs = static_cast<uint16_t>(endpoints.min.count()),
+            .maxUs = static_cast<uint16_t>(endpoints.max.count()),
+            .coldStepMs = static_cast<uint16_t>(std::chrono::duration_cast<MsTime>(armProfile.coldStep).count()),
+            .warmHoldMs = static_cast<uint16_t>(std::chrono::duration_cast<MsTime>(armProfile.warmHold).count()),
+            .warmWindowMs = static_cast<uint32_t>(std::chrono::duration_cast<MsTime>(armProfile.warmWindow).count()),
+        };
+
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(kNVSNamespace, NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error opening ESC calibration cache: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = nvs_set_blob(handle, calibrationKey(signature).data(), &stored, sizeof(stored));
+        if (err == ESP_OK) {
+            err = nvs_set_blob(handle, kLastSignatureKey, signature.data(), signature.size());
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+
+        if (err != ESP_OK) {
+            PCP_LOGE("Error caching ESC calibration: %s", esp_err_to_name(err));
+            return;
+        }
+        PCP_LOGI("Cached calibration for ESC %02x%02x: throttle %u-%uus", signature[0], signature[1], stored.minUs, stored.maxUs);
+    }
+
+    // The entry itself is left alone, it's still right for an ESC with that signature.
+    void invalidateCachedCalibrationForLastESC(void) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(kNVSNamespace, NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error opening ESC calibration cache: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = nvs_erase_key(handle, kLastSignatureKey);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            PCP_LOGE("Error invalidating ESC calibration cache: %s", esp_err_to_name(err));
+        }
+    }
+}  // namespace pcp
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ESC/BLHeli/BLHeliESCConfig.hpp"
+#include "ESC/ESCProtocol.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace pcp {
+    // What driving an ESC over an analog protocol needs to know that only its EEPROM can say.
+    struct BLHeliCalibration {
+        ESCThrottleEndpoints throttleEndpoints;
+        ESCArmProfile armProfile;
+        // The device signature of the ESC this was read from.
+        std::array<uint8_t, 2> signature{};
+    };
+
+    // Calibrations read from BLHeli ESCs, kept in NVS so later boots needn't go through the bootloader to
+    // find them.  Entries are keyed by device signature.  The signature of the ESC read most recently is
+    // kept as well, as nothing about an ESC can be known without entering its bootloader.  That also means
+    // a swapped ESC can only be noticed the next time its bootloader is entered, at which point the last
+    // ESC's entry should be invalidated.
+    std::optional<BLHeliCalibration> cachedCalibrationForLastESC(void);
+    void cacheCalibration(const BLHeliESCConfig& config);
+    void invalidateCachedCalibrationForLastESC(void);
+}  // namespace pcp
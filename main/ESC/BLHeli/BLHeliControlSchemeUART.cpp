@@ -11,14 +11,18 @@
 #include "esp_intr_alloc.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "soc/soc_caps.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #include <arpa/inet.h>
 
+#include <algorithm>
 #include <array>
 #include <format>
+#include <functional>
+#include <numeric>
 #include <tuple>
 
 namespace pcp {
@@ -26,6 +30,12 @@ namespace pcp {
 
     static constexpr uint32_t kInteruptPriority = 3;
 
+    // A frame's tail is handed over after this many idle byte times, and the FIFO threshold stays clear of
+    // the FIFO's 128 byte size.
+    static constexpr uint8_t kRxTimeoutSymbols = 2;
+    static constexpr size_t kMaxRxFullThreshold = 120;
+    static constexpr size_t kEchoChunkSize = 16;
+
     struct UserData {
         BLHeliControlSchemeUART* uartController;
         std::function<void(bool)> completion;
@@ -36,16 +46,9 @@ namespace pcp {
         uartController->_task();
     }
 
-    bool _timerEmpty(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* userInfo) {
+    bool _preambleTransmitted(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t* edata, void* userInfo) {
         BLHeliControlSchemeUART* uartController = reinterpret_cast<BLHeliControlSchemeUART*>(userInfo);
-        uartController->_configureGeneratorForPulse();
-        return true;
-    }
-
-    bool _timerStopped(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* userInfo) {
-        BLHeliControlSchemeUART* uartController = reinterpret_cast<BLHeliControlSchemeUART*>(userInfo);
-        uartController->_preambleDidEnd();
-        return true;
+        return uartController->_preambleDidEnd();
     }
 
     BLHeliControlSchemeUART::BLHeliControlSchemeUART() {
@@ -71,8 +74,8 @@ namespace pcp {
         if (uart_is_driver_installed(kMotorUART)) {
             uart_driver_delete(kMotorUART);
         }
-        if (_timerHandle != nullptr) {
-            _cleanupTimer();
+        if (_preambleChannel != nullptr) {
+            _cleanupPreambleChannel();
         }
     }
 
@@ -119,135 +122,12 @@ namespace pcp {
     void BLHeliControlSchemeUART::_attemptConnection() {
         _programModeEntryStep = ProgramModeEntryStep::RebootingESC;
 
-        bool success = _setupTimers();
+        bool success = _setupPreambleChannel();
         if (success) {
             _transmitPreamble();
         }
     }
 
-    bool BLHeliControlSchemeUART::_setupTimers(void) {
-        esp_err_t err = ESP_OK;
-
-        mcpwm_timer_config_t timerConfig = {.group_id = 0,
-                                            .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
-                                            .resolution_hz = 1'000'000,
-                                            .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
-                                            .period_ticks = 64,
-                                            .intr_priority = kInteruptPriority,
-                                            .flags = {
-                                                .update_period_on_empty = false,
-                                                .update_period_on_sync = false,
-                                                .allow_pd = false,
-                                            }};
-        err = mcpwm_new_timer(&timerConfig, &_timerHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while creating timer: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-
-        mcpwm_operator_config_t operatorConfig = {.group_id = 0,
-                                                  .intr_priority = kInteruptPriority,
-                                                  .flags = {
-                                                      .update_gen_action_on_tez = true,
-                                                      .update_gen_action_on_tep = true,
-                                                      .update_gen_action_on_sync = false,
-                                                      .update_dead_time_on_tez = false,
-                                                      .update_dead_time_on_tep = false,
-                                                      .update_dead_time_on_sync = false,
-                                                  }};
-        err = mcpwm_new_operator(&operatorConfig, &_operatorHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while creating operator: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-        err = mcpwm_operator_connect_timer(_operatorHandle, _timerHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while attaching operator to timer: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-
-        mcpwm_timer_event_callbacks_t timerCallbacks = {
-            .on_full = nullptr,
-            .on_empty = _timerEmpty,
-            .on_stop = _timerStopped,
-        };
-        err = mcpwm_timer_register_event_callbacks(_timerHandle, &timerCallbacks, this);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while setting up timer callbacks: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-
-        mcpwm_comparator_config_t comparatorConfig = {.intr_priority = kInteruptPriority,
-                                                      .flags{
-                                                          .update_cmp_on_tez = false,
-                                                          .update_cmp_on_tep = false,
-                                                          .update_cmp_on_sync = false,
-                                                      }};
-        err = mcpwm_new_comparator(_operatorHandle, &comparatorConfig, &_comparatorHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while creating comparator: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-        err = mcpwm_comparator_set_compare_value(_comparatorHandle, 32);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while setting comparator value: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-
-        mcpwm_generator_config_t generatorConfig = {.gen_gpio_num = kMotorOutputGPIO,
-                                                    .flags = {
-                                                        .invert_pwm = false,
-                                                        .io_loop_back = false,
-                                                        .io_od_mode = true,
-                                                        .pull_up = true,
-                                                        .pull_down = false,
-                                                    }};
-        err = mcpwm_new_generator(_operatorHandle, &generatorConfig, &_generatorHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while creating generator: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-        err = mcpwm_generator_set_force_level(_generatorHandle, 1, false);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while forcing generator to initialy output high: %s", esp_err_to_name(err));
-            _retryConnection();
-            return false;
-        }
-
-        return true;
-    }
-
-    void BLHeliControlSchemeUART::_cleanupTimer(void) {
-        if (_timerHandle != nullptr) {
-            mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_STOP_EMPTY);
-            mcpwm_timer_disable(_timerHandle);
-        }
-
-        if (_generatorHandle != nullptr) {
-            mcpwm_del_generator(_generatorHandle);
-            _generatorHandle = nullptr;
-        }
-        if (_comparatorHandle != nullptr) {
-            mcpwm_del_comparator(_comparatorHandle);
-            _comparatorHandle = nullptr;
-        }
-        if (_operatorHandle != nullptr) {
-            mcpwm_del_operator(_operatorHandle);
-            _operatorHandle = nullptr;
-        }
-        if (_timerHandle != nullptr) {
-            mcpwm_del_timer(_timerHandle);
-            _timerHandle = nullptr;
-        }
-    }
-
     enum class PulseWidth : uint8_t { Short = 0, Long = 1 };
 
     // What even is this shit?  I can't figure out what protocol is being used here, but somehow this gets you
@@ -284,104 +164,147 @@ namespace pcp {
          PulseWidth::Short, PulseWidth::Short, PulseWidth::Short, PulseWidth::Long,  PulseWidth::Long,  PulseWidth::Short, PulseWidth::Short, PulseWidth::Short,
          PulseWidth::Short, PulseWidth::Short, PulseWidth::Short, PulseWidth::Short, PulseWidth::Short, PulseWidth::Short});
 
-    bool BLHeliControlSchemeUART::_configureGeneratorForPulse() {
-        esp_err_t err = ESP_OK;
+    // The table alternates the line level with every entry, starting low.  A long entry holds its level for
+    // a whole period, and a pair of shorts holds it for half a period then swaps for the other half.  The
+    // table ends on a lone short, which is played as a pair.
+    static constexpr uint32_t kPreambleResolutionHz = 1'000'000;
+    static constexpr uint16_t kPreamblePeriodTicks = 64;
 
-        if (_preamblePulseNumber < _preamblePulseTiming.size()) {
-            const bool pulseStartsHigh = _preamblePulseNumber % 2 == 0;
-            const mcpwm_generator_action_t firstAction = pulseStartsHigh ? MCPWM_GEN_ACTION_LOW : MCPWM_GEN_ACTION_HIGH;
-            err = mcpwm_generator_set_action_on_timer_event(
-                _generatorHandle,
-                (mcpwm_gen_timer_event_action_t){.direction = MCPWM_TIMER_DIRECTION_UP, .event = MCPWM_TIMER_EVENT_EMPTY, .action = firstAction});
-            if (err != ESP_OK) {
-                PCP_LOGE("While setting generator to output on timer reset: %s", esp_err_to_name(err));
-                _retryConnection();
-                return false;
-            }
-            const PulseWidth pulseWidth = _preamblePulseTiming[_preamblePulseNumber];
-            if (pulseWidth == PulseWidth::Short) {
-                assert(_preamblePulseTiming[_preamblePulseNumber + 1] == PulseWidth::Short);
-                _preamblePulseNumber += 2;
-                err = mcpwm_generator_set_action_on_compare_event(
-                    _generatorHandle, (mcpwm_gen_compare_event_action_t){
-                                          .direction = MCPWM_TIMER_DIRECTION_UP, .comparator = _comparatorHandle, .action = MCPWM_GEN_ACTION_TOGGLE});
-                if (err != ESP_OK) {
-                    PCP_LOGE("Error occurred while setting generator to output invert on comparator match: %s", esp_err_to_name(err));
-                    _retryConnection();
-                    return false;
-                }
+    struct PreambleLevel {
+        bool high;
+        uint16_t ticks;
+    };
+
+    static constexpr size_t preambleLevelCount(void) {
+        size_t count = 0;
+        for (size_t i = 0; i < _preamblePulseTiming.size(); i += _preamblePulseTiming[i] == PulseWidth::Short ? 2 : 1) {
+            count += _preamblePulseTiming[i] == PulseWidth::Short ? 2 : 1;
+        }
+        return count;
+    }
+
+    static constexpr std::array<PreambleLevel, preambleLevelCount()> preambleLevels(void) {
+        std::array<PreambleLevel, preambleLevelCount()> levels = {};
+        size_t level = 0;
+        for (size_t i = 0; i < _preamblePulseTiming.size();) {
+            const bool high = i % 2 == 1;
+            if (_preamblePulseTiming[i] == PulseWidth::Short) {
+                assert(i + 1 == _preamblePulseTiming.size() || _preamblePulseTiming[i + 1] == PulseWidth::Short);
+                levels[level++] = {high, kPreamblePeriodTicks / 2};
+                levels[level++] = {!high, kPreamblePeriodTicks / 2};
+                i += 2;
             } else {
-                _preamblePulseNumber++;
-                err = mcpwm_generator_set_action_on_compare_event(
-                    _generatorHandle, (mcpwm_gen_compare_event_action_t){
-                                          .direction = MCPWM_TIMER_DIRECTION_UP, .comparator = _comparatorHandle, .action = MCPWM_GEN_ACTION_KEEP});
-                if (err != ESP_OK) {
-                    PCP_LOGE("Error occurred while setting generator to output equal on comparator match: %s", esp_err_to_name(err));
-                    _retryConnection();
-                    return false;
-                }
-            }
-        } else if (!_timerStopping) {
-            // If this is the last iteration, add an extra action - when the timer reaches the top
-            // set the output high, and then stop.  _preambleDidEnd() will then get called, which
-            // will disable the timer and start the uart communication.
-            _timerStopping = true;
-            err = mcpwm_generator_set_action_on_timer_event(
-                _generatorHandle,
-                (mcpwm_gen_timer_event_action_t){.direction = MCPWM_TIMER_DIRECTION_UP, .event = MCPWM_TIMER_EVENT_FULL, .action = MCPWM_GEN_ACTION_HIGH});
-            if (err != ESP_OK) {
-                PCP_LOGE("While setting generator to output on timer reset: %s", esp_err_to_name(err));
-                _retryConnection();
-                return false;
-            }
-            err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_STOP_EMPTY);
-            if (err != ESP_OK) {
-                PCP_LOGE("While stopping timer at end of preamble pulse sequence: %s", esp_err_to_name(err));
-                _retryConnection();
-                return false;
+                levels[level++] = {high, kPreamblePeriodTicks};
+                i++;
             }
         }
+        return levels;
+    }
 
-        return true;
+    static constexpr std::array<PreambleLevel, preambleLevelCount()> kPreambleLevels = preambleLevels();
+
+    // The channel's output is inverted so that it idles high, which means every level here is stored
+    // inverted too.  An odd level out is paired with a stretch of idle.
+    static constexpr rmt_symbol_word_t preambleSymbol(PreambleLevel first, PreambleLevel second) {
+        return {.val = static_cast<uint32_t>(first.ticks) | static_cast<uint32_t>(!first.high) << 15 | static_cast<uint32_t>(second.ticks) << 16 |
+                       static_cast<uint32_t>(!second.high) << 31};
     }
 
-    void BLHeliControlSchemeUART::_transmitPreamble() {
-        PCP_LOGD("Transmitting preamble");
+    static constexpr std::array<rmt_symbol_word_t, (kPreambleLevels.size() + 1) / 2> preambleSymbols(void) {
+        std::array<rmt_symbol_word_t, (kPreambleLevels.size() + 1) / 2> symbols = {};
+        for (size_t i = 0; i < symbols.size(); i++) {
+            const size_t second = 2 * i + 1;
+            const PreambleLevel idle = {true, kPreamblePeriodTicks / 2};
+            symbols[i] = preambleSymbol(kPreambleLevels[2 * i], second < kPreambleLevels.size() ? kPreambleLevels[second] : idle);
+        }
+        return symbols;
+    }
 
+    static constexpr std::array<rmt_symbol_word_t, (kPreambleLevels.size() + 1) / 2> kPreambleSymbols = preambleSymbols();
+
+    // The whole preamble sits in the channel's memory, so it goes out without the driver refilling it.
+    static constexpr size_t kPreambleMemorySymbols =
+        (kPreambleSymbols.size() + SOC_RMT_MEM_WORDS_PER_CHANNEL - 1) / SOC_RMT_MEM_WORDS_PER_CHANNEL * SOC_RMT_MEM_WORDS_PER_CHANNEL;
+    static_assert(kPreambleMemorySymbols <= SOC_RMT_MEM_WORDS_PER_CHANNEL * SOC_RMT_TX_CANDIDATES_PER_GROUP, "Preamble doesn't fit in RMT memory");
+
+    bool BLHeliControlSchemeUART::_setupPreambleChannel(void) {
         esp_err_t err = ESP_OK;
 
-        _preamblePulseNumber = 0;
-        _timerStopping = false;
-        bool success = _configureGeneratorForPulse();
-        if (!success) {
-            return;
+        rmt_tx_channel_config_t channelConfig = {.gpio_num = kMotorOutputGPIO,
+                                                 .clk_src = RMT_CLK_SRC_DEFAULT,
+                                                 .resolution_hz = kPreambleResolutionHz,
+                                                 .mem_block_symbols = kPreambleMemorySymbols,
+                                                 .trans_queue_depth = 1,
+                                                 .intr_priority = kInteruptPriority,
+                                                 .flags = {
+                                                     .invert_out = true,
+                                                     .with_dma = false,
+                                                     .io_loop_back = false,
+                                                     .io_od_mode = true,
+                                                     .allow_pd = false,
+                                                 }};
+        err = rmt_new_tx_channel(&channelConfig, &_preambleChannel);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while creating preamble channel: %s", esp_err_to_name(err));
+            _retryConnection();
+            return false;
         }
 
-        err = mcpwm_timer_enable(_timerHandle);
+        rmt_copy_encoder_config_t encoderConfig = {};
+        err = rmt_new_copy_encoder(&encoderConfig, &_preambleEncoder);
         if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while enabling timer: %s", esp_err_to_name(err));
+            PCP_LOGE("Error occurred while creating preamble encoder: %s", esp_err_to_name(err));
             _retryConnection();
-            return;
+            return false;
         }
-        err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_START_NO_STOP);
+
+        rmt_tx_event_callbacks_t callbacks = {.on_trans_done = _preambleTransmitted};
+        err = rmt_tx_register_event_callbacks(_preambleChannel, &callbacks, this);
         if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while starting timer: %s", esp_err_to_name(err));
+            PCP_LOGE("Error occurred while setting up preamble callbacks: %s", esp_err_to_name(err));
             _retryConnection();
-            return;
+            return false;
+        }
+
+        err = rmt_enable(_preambleChannel);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while enabling preamble channel: %s", esp_err_to_name(err));
+            _retryConnection();
+            return false;
         }
+
+        return true;
     }
 
-    void BLHeliControlSchemeUART::_preambleDidEnd(void) {
-        esp_err_t err = ESP_OK;
-        err = mcpwm_generator_set_force_level(_generatorHandle, 1, false);
+    void BLHeliControlSchemeUART::_cleanupPreambleChannel(void) {
+        if (_preambleChannel != nullptr) {
+            rmt_disable(_preambleChannel);
+            rmt_del_channel(_preambleChannel);
+            _preambleChannel = nullptr;
+        }
+        if (_preambleEncoder != nullptr) {
+            rmt_del_encoder(_preambleEncoder);
+            _preambleEncoder = nullptr;
+        }
+    }
+
+    void BLHeliControlSchemeUART::_transmitPreamble() {
+        PCP_LOGD("Transmitting preamble");
+
+        rmt_transmit_config_t transmitConfig = {.loop_count = 0, .flags = {.eot_level = 0, .queue_nonblocking = false}};
+        esp_err_t err = rmt_transmit(_preambleChannel, _preambleEncoder, kPreambleSymbols.data(), sizeof(kPreambleSymbols), &transmitConfig);
         if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while forcing generator to initialy output high: %s", esp_err_to_name(err));
+            PCP_LOGE("Error occurred while transmitting preamble: %s", esp_err_to_name(err));
             _retryConnection();
-            return;
         }
+    }
 
+    // Called from the RMT ISR once the last symbol is out, leaving the line idling high.
+    bool BLHeliControlSchemeUART::_preambleDidEnd(void) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
         _programModeEntryStep = ProgramModeEntryStep::ReadyForUART;
-        xSemaphoreGive(_taskSemaphore);
+        xSemaphoreGiveFromISR(_taskSemaphore, &higherPriorityTaskWoken);
+        return higherPriorityTaskWoken == pdTRUE;
     }
 
     void BLHeliControlSchemeUART::_beginUART(void) {
@@ -389,7 +312,7 @@ namespace pcp {
 
         PCP_LOGD("Opening UART connection to ESC");
 
-        _cleanupTimer();
+        _cleanupPreambleChannel();
 
         esp_err_t err = ESP_OK;
 
@@ -418,6 +341,12 @@ namespace pcp {
             _retryConnection();
             return;
         }
+        err = uart_set_rx_timeout(kMotorUART, kRxTimeoutSymbols);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error setting UART receive timeout: %s", esp_err_to_name(err));
+            _retryConnection();
+            return;
+        }
 
         // If we're using the same pin for transmit and receive we must configure the gpio to have an open drain and a pullup.  This stops us from burning out the pin.
         gpio_config_t gpioConfig = {
@@ -441,15 +370,24 @@ namespace pcp {
         const size_t kExpectedResponseLength = 8;
         const size_t kPreambleLength = sizeof(preamble) / sizeof(preamble[0]);
         const size_t kHandshakeLength = sizeof(handshake) / sizeof(handshake[0]);
-        size_t transmittedBytes = _writeBytes(preamble, kPreambleLength, false);
-        transmittedBytes += _writeBytes(handshake, kHandshakeLength, true);
+        _writeBytes(preamble, kPreambleLength, false);
+        _writeBytes(handshake, kHandshakeLength, true);
+        BootloaderResultCode echo = _discardEcho(preamble, kPreambleLength, false, 100_ms);
+        if (echo == BootloaderResultCode::Success) {
+            echo = _discardEcho(handshake, kHandshakeLength, true, 100_ms);
+        }
+        if (echo != BootloaderResultCode::Success) {
+            PCP_LOGE("Handshake was not echoed back: %s", to_string(echo).c_str());
+            _retryConnection();
+            return;
+        }
 
         const size_t kReadBufferLength = 256;
         uint8_t readBuffer[kReadBufferLength];
-        size_t bytesRead = _readBytes(readBuffer, kReadBufferLength - 1, 100 / portTICK_PERIOD_MS);
+        size_t bytesRead = _readBytes(readBuffer, kReadBufferLength - 1, 100_ms);
         readBuffer[bytesRead] = '\0';
 
-        if (bytesRead < kPreambleLength + kHandshakeLength + kExpectedResponseLength) {
+        if (bytesRead < kExpectedResponseLength) {
             PCP_LOGE("Did not get expected response from ESC after handshake");
             _retryConnection();
             return;
@@ -479,14 +417,14 @@ namespace pcp {
         if (_numRetries < kMaxRetries) {
             _numRetries++;
 
-            _cleanupTimer();
+            _cleanupPreambleChannel();
 
             if (uart_is_driver_installed(kMotorUART)) {
                 uart_driver_delete(kMotorUART);
             }
 
             gpio_set_level(kMotorOutputGPIO, 1);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
+            vTaskDelay(ticksToWait(200_ms));
 
             _attemptConnection();
         } else {
@@ -503,10 +441,7 @@ namespace pcp {
     }
 
     BootloaderResult<BLHeliESCConfig> BLHeliControlSchemeUART::_getDeviceConfig(const uint8_t* handshake) {
-        static constexpr uint16_t kDeviceLayoutLocation = 0x1a00;
-        static constexpr uint16_t kDeviceLayoutLength = 0x0070;
-
-        BootloaderResult<std::vector<uint8_t>> deviceConfigMemory = readMemory(kDeviceLayoutLocation, kDeviceLayoutLength, 1000 / portTICK_PERIOD_MS);
+        BootloaderResult<std::vector<uint8_t>> deviceConfigMemory = readMemory(kBLHeliEEPROMAddress, kBLHeliEEPROMSize, 1000_ms);
         if (!deviceConfigMemory) {
             PCP_LOGE("Could not read memory: %s", std::to_string(deviceConfigMemory).c_str());
             return BootloaderResult<BLHeliESCConfig>(deviceConfigMemory.resultCode());
@@ -523,7 +458,7 @@ namespace pcp {
         return BootloaderResult<BLHeliESCConfig>(device.value());
     }
 
-    BootloaderResult<std::vector<uint8_t>> BLHeliControlSchemeUART::readMemory(uint16_t address, uint8_t length, TickType_t timeout) {
+    BootloaderResult<std::vector<uint8_t>> BLHeliControlSchemeUART::readMemory(uint16_t address, uint8_t length, MsTime timeout) {
         BootloaderResult<Void> success = _setAddress(address, timeout);
         if (!success) {
             PCP_LOGE("Could not set address: %s", std::to_string(success).c_str());
@@ -532,6 +467,71 @@ namespace pcp {
         return _readMemory(length, timeout);
     }
 
+    bool BLHeliControlSchemeUART::dumpFlash(uint32_t length, const FlashSink& sink, MsTime blockTimeout) {
+        static constexpr size_t kBlockAttempts = 3;
+
+        // Time spent reading, leaving out the sink, so the log shows what the wire and bootloader manage.
+        UsTime readTime = 0_us;
+        for (uint32_t address = 0; address < length; address += kFlashBlockSize) {
+            const size_t blockLength = std::min<size_t>(length - address, kFlashBlockSize);
+            BootloaderResultCode result = BootloaderResultCode::ErrorNone;
+            for (size_t attempt = 0; attempt < kBlockAttempts && result != BootloaderResultCode::Success; attempt++) {
+                const EspTimerClock::time_point start = EspTimerClock::now();
+                result = _readFlash(static_cast<uint16_t>(address), _blockBuffer.data(), blockLength, blockTimeout);
+                readTime += std::chrono::duration_cast<UsTime>(EspTimerClock::now() - start);
+                if (result != BootloaderResultCode::Success) {
+                    PCP_LOGW("Reading flash at 0x%04lx failed: %s", (unsigned long)address, to_string(result).c_str());
+                    uart_flush_input(kMotorUART);
+                }
+            }
+            if (result != BootloaderResultCode::Success) {
+                PCP_LOGE("Giving up on flash dump at 0x%04lx", (unsigned long)address);
+                return false;
+            }
+
+            if (!sink(static_cast<uint16_t>(address), _blockBuffer.data(), blockLength)) {
+                return false;
+            }
+        }
+        PCP_LOGD("Read %lu bytes of flash in %lldus, %lld B/s", (unsigned long)length, (long long)readTime.count(),
+                 readTime.count() > 0 ? (long long)length * 1'000'000 / readTime.count() : 0);
+        return true;
+    }
+
+    bool BLHeliControlSchemeUART::writeConfig(const BLHeliESCConfig& config) {
+        if (!_esc.has_value()) {
+            PCP_LOGE("Can't write settings without having read them from the ESC");
+            return false;
+        }
+
+        const std::array<uint8_t, kBLHeliEEPROMSize> current = _esc->eepromBytes();
+        const std::array<uint8_t, kBLHeliEEPROMSize> desired = config.eepromBytes();
+        const size_t changedBytes = std::inner_product(current.begin(), current.end(), desired.begin(), size_t(0), std::plus<>(), std::not_equal_to<>());
+        if (changedBytes == 0) {
+            PCP_LOGI("ESC settings unchanged, not writing");
+            return true;
+        }
+
+        PCP_LOGI("Writing %u changed EEPROM bytes", (unsigned)changedBytes);
+        if (!_writeFlashPage(kBLHeliEEPROMAddress, desired.data(), desired.size())) {
+            return false;
+        }
+        _esc = config;
+        return true;
+    }
+
+    // The bootloader jumps straight to the firmware without acknowledging, so there's nothing to wait for
+    // beyond the command going out.
+    void BLHeliControlSchemeUART::runApplication(void) {
+        const uint8_t message[] = {to_uint8(BootloaderCommandType::Run), 0x00};
+        _writeBytes(message, sizeof(message), true);
+        const BootloaderResultCode echo = _discardEcho(message, sizeof(message), true, 100_ms);
+        if (echo != BootloaderResultCode::Success) {
+            PCP_LOGE("Error sending run command: %s", to_string(echo).c_str());
+        }
+        _escState = ESCState::Disarmed;
+    }
+
     constexpr uint16_t kCRCLength = 2;
     constexpr uint16_t kAckLength = 1;
 
@@ -543,9 +543,14 @@ namespace pcp {
         return static_cast<BootloaderResultCode>(responseData[ackLocation(expectedDataLength)]);
     }
 
+    // The bootloader sends its CRC low byte first, the same way round as ours.
     uint16_t crc(const uint8_t* responseData, uint16_t expectedDataLength) {
         assert(expectedDataLength != 0);
-        return ntohs(*(reinterpret_cast<const uint16_t*>(responseData + expectedDataLength)));
+        return responseData[expectedDataLength] | responseData[expectedDataLength + 1] << 8;
+    }
+
+    bool crcMatches(const uint8_t* responseData, uint16_t expectedDataLength) {
+        return expectedDataLength == 0 || crc(responseData, expectedDataLength) == crc_16_ibm(responseData, expectedDataLength);
     }
 
     constexpr uint16_t responseBufferSize(uint16_t expectedDataLength) {
@@ -566,53 +571,207 @@ namespace pcp {
     }
 
     template <BootloaderCommandType cmd>
-    BootloaderResult<typename BootloaderCommand<cmd>::ReturnType> BLHeliControlSchemeUART::_runCommand(BootloaderCommand<cmd> command, TickType_t timeout) {
-        using return_type = BootloaderCommand<cmd>::ReturnType;
-
-        std::vector<uint8_t> message = {to_uint8(cmd), 0x00};
+    BLHeliControlSchemeUART::Frame BLHeliControlSchemeUART::_frame(BootloaderCommand<cmd> command) {
+        Frame frame = {.bytes = {to_uint8(cmd), 0x00}, .length = 2, .responseLength = command.expectedReturnBytes()};
         if constexpr (command.hasCommandData) {
-            message[1] = command.commandData;
+            frame.bytes[1] = command.commandData;
         }
         if constexpr (command.hasArgument) {
             uint8_t* argumentPtr = reinterpret_cast<uint8_t*>(&command.argument);
-            message.push_back(argumentPtr[0]);
-            message.push_back(argumentPtr[1]);
-        }
-        const size_t messageBufferSize = message.size();
-        const size_t transmittedBytes = _writeBytes(message.data(), messageBufferSize, true);
-
-        const size_t expectedResponseLength = command.expectedReturnBytes();
-        const size_t expectedReadBytes = transmittedBytes + responseBufferSize(expectedResponseLength);
-        uint8_t allReadBytes[expectedReadBytes];
-        size_t bytesRead = 0;
-        const uint16_t startTime = esp_timer_get_time();
-        while (bytesRead < expectedReadBytes) {
-            bytesRead += _readBytes(allReadBytes + bytesRead, expectedReadBytes - bytesRead, timeout);
-            const uint16_t now = esp_timer_get_time();
-            if (now - startTime > timeout * portTICK_PERIOD_MS * 1000) {
-                break;
+            frame.bytes[frame.length++] = argumentPtr[0];
+            frame.bytes[frame.length++] = argumentPtr[1];
+        }
+        const uint16_t crc = crc_16_ibm(frame.bytes.data(), frame.length);
+        memcpy(frame.bytes.data() + frame.length, &crc, sizeof(crc));
+        frame.length += sizeof(crc);
+        return frame;
+    }
+
+    static constexpr size_t kMaxResponseLength = 256;
+
+    template <BootloaderCommandType cmd>
+    BootloaderResult<typename BootloaderCommand<cmd>::ReturnType> BLHeliControlSchemeUART::_runCommand(BootloaderCommand<cmd> command, UsTime timeout) {
+        using return_type = BootloaderCommand<cmd>::ReturnType;
+
+        const Frame frame = _frame(command);
+        const EspTimerClock::time_point start = EspTimerClock::now();
+        uint8_t response[kMaxResponseLength];
+        const BootloaderResultCode resultCode = _exchange(frame, response, timeout);
+        if (resultCode != BootloaderResultCode::Success) {
+            return BootloaderResult<return_type>(resultCode);
+        }
+        // From the first byte going out to the last byte of the reply being handed over, so it covers the
+        // wire time, the bootloader's turnaround and the driver's wake.
+        PCP_LOGD("Command 0x%02x round trip %lldus for %u bytes", to_uint8(cmd),
+                 (long long)std::chrono::duration_cast<UsTime>(EspTimerClock::now() - start).count(),
+                 (unsigned)(frame.length + responseBufferSize(frame.responseLength)));
+        return BootloaderResult<return_type>(getReadBytes<return_type>(response, frame.responseLength));
+    }
+
+    // Sends a frame and waits for its whole answer; nothing else goes out until then.  A command that fails
+    // answers with its ack byte alone, so if the line goes quiet after the first byte of a data reply, that
+    // byte is the ack and is returned straight away rather than after the timeout.  Response data, if any, is
+    // copied to responseData.
+    BootloaderResultCode BLHeliControlSchemeUART::_exchange(const Frame& frame, uint8_t* responseData, UsTime timeout) {
+        static constexpr UsTime kReplyGap = 2_ms;
+
+        const EspTimerClock::time_point deadline = EspTimerClock::now() + timeout;
+        const size_t replyLength = responseBufferSize(frame.responseLength);
+        uint8_t reply[responseBufferSize(kMaxResponseLength)];
+        assert(replyLength <= sizeof(reply));
+
+        _writeBytes(frame.bytes.data(), frame.length, false);
+        const BootloaderResultCode echo = _discardEcho(frame.bytes.data(), frame.length, false, timeout);
+        if (echo != BootloaderResultCode::Success) {
+            return echo;
+        }
+
+        if (_readBytes(reply, 1, deadline - EspTimerClock::now()) < 1) {
+            return BootloaderResultCode::ErrorTimeout;
+        }
+        if (replyLength > 1) {
+            if (_readBytes(reply + 1, 1, kReplyGap) < 1) {
+                const BootloaderResultCode loneAck = static_cast<BootloaderResultCode>(reply[0]);
+                return loneAck == BootloaderResultCode::Success ? BootloaderResultCode::ErrorTimeout : loneAck;
+            }
+            if (_readBytes(reply + 2, replyLength - 2, deadline - EspTimerClock::now()) < replyLength - 2) {
+                return BootloaderResultCode::ErrorTimeout;
             }
         }
-        if (bytesRead < expectedReadBytes) {
-            return BootloaderResult<return_type>(BootloaderResultCode::ErrorTimeout);
+
+        const BootloaderResultCode resultCode = ack(reply, frame.responseLength);
+        if (resultCode != BootloaderResultCode::Success) {
+            return resultCode;
+        }
+        if (!crcMatches(reply, frame.responseLength)) {
+            return BootloaderResultCode::ErrorCRC;
         }
-        const uint8_t* response = allReadBytes + transmittedBytes;
+        if (frame.responseLength > 0) {
+            memcpy(responseData, reply, frame.responseLength);
+        }
+        return BootloaderResultCode::Success;
+    }
 
-        BootloaderResultCode resultCode = ack(response, expectedResponseLength);
-        if (resultCode == BootloaderResultCode::Success) {
-            return BootloaderResult<return_type>(getReadBytes<return_type>(response, expectedResponseLength));
-        } else {
-            return BootloaderResult<return_type>(resultCode);
+    // The bootloader doesn't answer SetBuffer itself, only the data that follows it.  Anything that does come
+    // back before the data goes out is an error.
+    BootloaderResultCode BLHeliControlSchemeUART::_setBuffer(const uint8_t* bytes, size_t length, UsTime timeout) {
+        static constexpr UsTime kUnexpectedReplyWait = 2_ms;
+
+        BootloaderCommand<BootloaderCommandType::SetBuffer> setBuffer;
+        setBuffer.argument = htons(static_cast<uint16_t>(length));
+        const Frame frame = _frame(setBuffer);
+        const EspTimerClock::time_point deadline = EspTimerClock::now() + timeout;
+
+        _writeBytes(frame.bytes.data(), frame.length, false);
+        BootloaderResultCode result = _discardEcho(frame.bytes.data(), frame.length, false, timeout);
+        if (result != BootloaderResultCode::Success) {
+            return result;
+        }
+        uint8_t reply = 0;
+        if (_readBytes(&reply, 1, kUnexpectedReplyWait) > 0) {
+            return static_cast<BootloaderResultCode>(reply);
+        }
+
+        _writeBytes(bytes, length, true);
+        result = _discardEcho(bytes, length, true, deadline - EspTimerClock::now());
+        if (result != BootloaderResultCode::Success) {
+            return result;
+        }
+        if (_readBytes(&reply, 1, deadline - EspTimerClock::now()) < 1) {
+            return BootloaderResultCode::ErrorTimeout;
         }
+        return static_cast<BootloaderResultCode>(reply);
     }
 
-    BootloaderResult<Void> BLHeliControlSchemeUART::_setAddress(uint16_t address, TickType_t timeout) {
+    // At most one block, read straight into bytes.
+    BootloaderResultCode BLHeliControlSchemeUART::_readFlash(uint16_t address, uint8_t* bytes, size_t length, UsTime timeout) {
+        assert(length > 0 && length <= kFlashBlockSize);
+        const EspTimerClock::time_point deadline = EspTimerClock::now() + timeout;
+        BootloaderCommand<BootloaderCommandType::SetAddress> setAddress;
+        setAddress.argument = htons(address);
+        const BootloaderResultCode result = _exchange(_frame(setAddress), nullptr, timeout);
+        if (result != BootloaderResultCode::Success) {
+            return result;
+        }
+        BootloaderCommand<BootloaderCommandType::ReadFlash> readFlash;
+        // A whole block wraps round to 0, which is how the bootloader asks for 256 bytes.
+        readFlash.commandData = static_cast<uint8_t>(length);
+        return _exchange(_frame(readFlash), bytes, deadline - EspTimerClock::now());
+    }
+
+    // Replaces the start of the page at address with bytes, keeping the rest of the page.  The whole page is
+    // read first, as erasing it takes everything after bytes with it (the startup melody follows the EEPROM
+    // settings, for instance).  It's then programmed back a block at a time, leaving trailing 0xff bytes to
+    // the erase, and read back to check.
+    bool BLHeliControlSchemeUART::_writeFlashPage(uint16_t address, const uint8_t* bytes, size_t length) {
+        static constexpr UsTime kReadTimeout = 500_ms;
+        static constexpr UsTime kEraseTimeout = 500_ms;
+        static constexpr UsTime kProgramTimeout = 500_ms;
+        static_assert(kBLHeliFlashPageSize % kFlashBlockSize == 0);
+        assert(address % kBLHeliFlashPageSize == 0 && length <= kBLHeliFlashPageSize);
+
+        BootloaderResultCode result = BootloaderResultCode::Success;
+        for (size_t offset = 0; offset < _pageBuffer.size() && result == BootloaderResultCode::Success; offset += kFlashBlockSize) {
+            result = _readFlash(address + offset, _pageBuffer.data() + offset, kFlashBlockSize, kReadTimeout);
+        }
+        if (result != BootloaderResultCode::Success) {
+            PCP_LOGE("Error reading flash page at 0x%04x: %s", address, to_string(result).c_str());
+            return false;
+        }
+        memcpy(_pageBuffer.data(), bytes, length);
+
+        BootloaderCommand<BootloaderCommandType::SetAddress> setAddress;
+        setAddress.argument = htons(address);
+        result = _exchange(_frame(setAddress), nullptr, kEraseTimeout);
+        if (result == BootloaderResultCode::Success) {
+            result = _exchange(_frame(BootloaderCommand<BootloaderCommandType::EraseFlash>()), nullptr, kEraseTimeout);
+        }
+        if (result != BootloaderResultCode::Success) {
+            PCP_LOGE("Error erasing flash page at 0x%04x: %s", address, to_string(result).c_str());
+            return false;
+        }
+
+        for (size_t offset = 0; offset < _pageBuffer.size(); offset += kFlashBlockSize) {
+            const uint8_t* block = _pageBuffer.data() + offset;
+            size_t programLength = kFlashBlockSize;
+            while (programLength > 0 && block[programLength - 1] == 0xff) {
+                programLength--;
+            }
+            if (programLength == 0) {
+                continue;
+            }
+
+            setAddress.argument = htons(static_cast<uint16_t>(address + offset));
+            result = _exchange(_frame(setAddress), nullptr, kProgramTimeout);
+            if (result == BootloaderResultCode::Success) {
+                result = _setBuffer(block, programLength, kProgramTimeout);
+            }
+            if (result == BootloaderResultCode::Success) {
+                result = _exchange(_frame(BootloaderCommand<BootloaderCommandType::ProgramFlash>()), nullptr, kProgramTimeout);
+            }
+            if (result != BootloaderResultCode::Success) {
+                PCP_LOGE("Error programming flash at 0x%04x: %s", (unsigned)(address + offset), to_string(result).c_str());
+                return false;
+            }
+        }
+
+        for (size_t offset = 0; offset < _pageBuffer.size(); offset += kFlashBlockSize) {
+            result = _readFlash(address + offset, _blockBuffer.data(), kFlashBlockSize, kReadTimeout);
+            if (result != BootloaderResultCode::Success || memcmp(_blockBuffer.data(), _pageBuffer.data() + offset, kFlashBlockSize) != 0) {
+                PCP_LOGE("Flash at 0x%04x doesn't read back as written: %s", (unsigned)(address + offset), to_string(result).c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    BootloaderResult<Void> BLHeliControlSchemeUART::_setAddress(uint16_t address, UsTime timeout) {
         BootloaderCommand<BootloaderCommandType::SetAddress> cmd;
         cmd.argument = htons(address);
         return _runCommand(cmd, timeout);
     }
 
-    BootloaderResult<std::vector<uint8_t>> BLHeliControlSchemeUART::_readMemory(uint8_t length, TickType_t timeout) {
+    BootloaderResult<std::vector<uint8_t>> BLHeliControlSchemeUART::_readMemory(uint8_t length, UsTime timeout) {
         BootloaderCommand<BootloaderCommandType::ReadFlash> cmd;
         cmd.commandData = length;
         return _runCommand(cmd, timeout);
@@ -629,7 +788,64 @@ namespace pcp {
         return transmittedBytes;
     }
 
-    size_t BLHeliControlSchemeUART::_readBytes(uint8_t* bytes, size_t length, TickType_t ticksToWait) {
-        return uart_read_bytes(kMotorUART, bytes, length, ticksToWait);
+    // TX and RX share the motor wire, so everything sent comes straight back.  The echo is compared against
+    // what was sent a chunk at a time and dropped, so a mismatch (something else driving the line) shows up
+    // as soon as the bad byte arrives.
+    BootloaderResultCode BLHeliControlSchemeUART::_discardEcho(const uint8_t* bytes, size_t length, bool crc, UsTime timeout) {
+        const EspTimerClock::time_point deadline = EspTimerClock::now() + timeout;
+        const uint16_t crcValue = crc ? crc_16_ibm(bytes, length) : 0;
+        const uint8_t* crcBytes = reinterpret_cast<const uint8_t*>(&crcValue);
+        const size_t echoLength = length + (crc ? sizeof(crcValue) : 0);
+
+        uint8_t chunk[kEchoChunkSize];
+        size_t offset = 0;
+        while (offset < echoLength) {
+            const size_t chunkLength = std::min(echoLength - offset, kEchoChunkSize);
+            const size_t received = _readBytes(chunk, chunkLength, deadline - EspTimerClock::now());
+            for (size_t i = 0; i < received; i++, offset++) {
+                const uint8_t sent = offset < length ? bytes[offset] : crcBytes[offset - length];
+                if (chunk[i] != sent) {
+                    PCP_LOGW("Bus collision: sent 0x%02x but read back 0x%02x at byte %u", sent, chunk[i], (unsigned)offset);
+                    uart_flush_input(kMotorUART);
+                    return BootloaderResultCode::ErrorCollision;
+                }
+            }
+            if (received < chunkLength) {
+                return BootloaderResultCode::ErrorTimeout;
+            }
+        }
+        return BootloaderResultCode::Success;
+    }
+
+    // Sleeps on the driver's event queue until length bytes are buffered, rather than polling reads.  The
+    // FIFO threshold is set to what's still missing, so the last byte of a frame wakes the task straight
+    // away instead of after the RX timeout.
+    size_t BLHeliControlSchemeUART::_readBytes(uint8_t* bytes, size_t length, UsTime timeout) {
+        const EspTimerClock::time_point deadline = EspTimerClock::now() + timeout;
+
+        size_t buffered = 0;
+        uart_get_buffered_data_len(kMotorUART, &buffered);
+        while (buffered < length) {
+            uart_set_rx_full_threshold(kMotorUART, static_cast<int>(std::min(length - buffered, kMaxRxFullThreshold)));
+
+            uart_event_t event;
+            if (xQueueReceive(_uartQueue, &event, ticksToWait(deadline - EspTimerClock::now())) != pdTRUE) {
+                break;
+            }
+
+            switch (event.type) {
+                case UART_FIFO_OVF:  // fallthrough
+                case UART_BUFFER_FULL:
+                    PCP_LOGW("UART receive overflowed, dropping buffered data");
+                    uart_flush_input(kMotorUART);
+                    xQueueReset(_uartQueue);
+                    return 0;
+                default:
+                    break;
+            }
+            uart_get_buffered_data_len(kMotorUART, &buffered);
+        }
+
+        return uart_read_bytes(kMotorUART, bytes, std::min(buffered, length), 0);
     }
 }  // namespace pcp
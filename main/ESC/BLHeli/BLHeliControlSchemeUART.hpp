@@ -3,16 +3,16 @@
 #include "ESC/BLHeli/BLHeliESCConfig.hpp"
 #include "ESC/BLHeli/BootloaderCommand.hpp"
 #include "ESC/ESC.hpp"
+#include "Utilities/Time.hpp"
 #include "Utilities/Void.hpp"
 #include "Utilities/to_stringExtras.hpp"
 
-#include "driver/mcpwm_cmpr.h"
-#include "driver/mcpwm_gen.h"
-#include "driver/mcpwm_oper.h"
-#include "driver/mcpwm_timer.h"
+#include "driver/rmt_encoder.h"
+#include "driver/rmt_tx.h"
 #include "driver/uart.h"
 
 #include <string.h>
+#include <array>
 #include <format>
 #include <mutex>
 #include <optional>
@@ -45,17 +45,31 @@ namespace pcp {
             return _escState == ESCState::Programming ? std::optional<BLHeliESCConfig>(_esc) : std::optional<BLHeliESCConfig>();
         }
 
-        BootloaderResult<std::vector<uint8_t>> readMemory(uint16_t address, uint8_t length, TickType_t timeout = 200 / portTICK_PERIOD_MS);
+        BootloaderResult<std::vector<uint8_t>> readMemory(uint16_t address, uint8_t length, MsTime timeout = 200_ms);
+
+        static constexpr size_t kFlashBlockSize = 256;
+        using FlashSink = std::function<bool(uint16_t address, const uint8_t* bytes, size_t length)>;
+
+        // Reads the first length bytes of the ESC's flash in whole blocks, each checked against its CRC, and
+        // hands them to sink as they arrive.  Every block is read into the same buffer, which sink mustn't
+        // hold on to.  Stops early if a block can't be read or sink returns false.
+        bool dumpFlash(uint32_t length, const FlashSink& sink, MsTime blockTimeout = 500_ms);
+
+        // Writes config to the ESC's EEPROM if any of its bytes differ from what the ESC holds, then reads it
+        // back to check.
+        bool writeConfig(const BLHeliESCConfig& config);
+
+        // Leaves the bootloader and starts the ESC's firmware, ready for arming.
+        void runApplication(void);
 
     private:
         void _task(void);
 
         void _attemptConnection(void);
-        bool _setupTimers(void);
-        void _cleanupTimer(void);
-        bool _configureGeneratorForPulse(void);
+        bool _setupPreambleChannel(void);
+        void _cleanupPreambleChannel(void);
         void _transmitPreamble(void);
-        void _preambleDidEnd(void);
+        bool _preambleDidEnd(void);
         void _beginUART(void);
         void _retryConnection(void);
         void _connectionFinished(bool success);
@@ -63,7 +77,8 @@ namespace pcp {
         BootloaderResult<BLHeliESCConfig> _getDeviceConfig(const uint8_t* handshake);
 
         size_t _writeBytes(const uint8_t* bytes, size_t length, bool crc);
-        size_t _readBytes(uint8_t* bytes, size_t length, TickType_t timeout);
+        BootloaderResultCode _discardEcho(const uint8_t* bytes, size_t length, bool crc, UsTime timeout);
+        size_t _readBytes(uint8_t* bytes, size_t length, UsTime timeout);
 
         template <typename T>
         size_t expectedReturnBytes();
@@ -71,24 +86,33 @@ namespace pcp {
         template <typename T>
         T getReadBytes(const uint8_t* buffer, size_t length);
 
+        // A command as it goes out on the wire, CRC included, and the length of the data it answers with.
+        struct Frame {
+            std::array<uint8_t, 6> bytes;
+            size_t length;
+            size_t responseLength;
+        };
+
         template <BootloaderCommandType cmd>
-        BootloaderResult<typename BootloaderCommand<cmd>::ReturnType> _runCommand(BootloaderCommand<cmd> command, TickType_t timeout);
+        Frame _frame(BootloaderCommand<cmd> command);
 
-        BootloaderResult<Void> _setAddress(uint16_t address, TickType_t timeout);
-        // BootloaderResult<Void> _setBuffer(uint16_t length, TickType_t timeout);
-        BootloaderResult<std::vector<uint8_t>> _readMemory(uint8_t length, TickType_t timeout);
+        template <BootloaderCommandType cmd>
+        BootloaderResult<typename BootloaderCommand<cmd>::ReturnType> _runCommand(BootloaderCommand<cmd> command, UsTime timeout);
+
+        BootloaderResultCode _exchange(const Frame& frame, uint8_t* responseData, UsTime timeout);
 
-        mcpwm_timer_handle_t _timerHandle;
-        mcpwm_oper_handle_t _operatorHandle;
-        mcpwm_gen_handle_t _generatorHandle;
-        mcpwm_cmpr_handle_t _comparatorHandle;
+        BootloaderResult<Void> _setAddress(uint16_t address, UsTime timeout);
+        BootloaderResultCode _readFlash(uint16_t address, uint8_t* bytes, size_t length, UsTime timeout);
+        BootloaderResultCode _setBuffer(const uint8_t* bytes, size_t length, UsTime timeout);
+        bool _writeFlashPage(uint16_t address, const uint8_t* bytes, size_t length);
+        BootloaderResult<std::vector<uint8_t>> _readMemory(uint8_t length, UsTime timeout);
+
+        rmt_channel_handle_t _preambleChannel = nullptr;
+        rmt_encoder_handle_t _preambleEncoder = nullptr;
 
         ESCState _escState;
         ProgramModeEntryStep _programModeEntryStep;
 
-        uint8_t _preamblePulseNumber;
-        bool _timerStopping = false;
-
         QueueHandle_t _uartQueue = nullptr;
         SemaphoreHandle_t _taskSemaphore;
         std::vector<Completion> _connectionCompletions;
@@ -96,10 +120,11 @@ namespace pcp {
         size_t _numRetries = 0;
 
         std::optional<BLHeliESCConfig> _esc;
+        std::array<uint8_t, kFlashBlockSize> _blockBuffer;
+        std::array<uint8_t, kBLHeliFlashPageSize> _pageBuffer;
 
         friend void _uartTaskF(void*);
-        friend bool _timerEmpty(mcpwm_timer_handle_t, const mcpwm_timer_event_data_t*, void*);
-        friend bool _timerStopped(mcpwm_timer_handle_t, const mcpwm_timer_event_data_t*, void*);
+        friend bool _preambleTransmitted(rmt_channel_handle_t, const rmt_tx_done_event_data_t*, void*);
         friend class ESCDevice;
     };
 }  // namespace pcp
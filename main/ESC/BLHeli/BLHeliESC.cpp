@@ -1,6 +1,21 @@
 #include "ESC/BLHeli/BLHeliESC.hpp"
 
+#include "ESC/BLHeli/BLHeliCalibrationCache.hpp"
+
+#include <semaphore>
+
 namespace pcp {
+    BLHeliESC::BLHeliESC(ESCProtocol protocol, bool bidirectionalDShot, uint8_t motorPoles, gpio_num_t outputGPIO)
+        : _protocol(protocol), _bidirectionalDShot(bidirectionalDShot && isDShot(protocol)), _motorPoles(motorPoles), _outputGPIO(outputGPIO) {
+        PCP_LOGI("BLHeli ESC using %s, worst case output stage latency %lu ns", to_string(protocol).c_str(),
+                 (unsigned long)worstCaseSetpointLatencyNs(protocol));
+    }
+
+    BLHeliESC::BLHeliESC(std::shared_ptr<ESCPWMTimer> sharedTimer, gpio_num_t outputGPIO)
+        : _protocol(sharedTimer->protocol()), _bidirectionalDShot(false), _motorPoles(14), _outputGPIO(outputGPIO), _sharedTimer(std::move(sharedTimer)) {
+        PCP_LOGI("BLHeli ESC using %s on a shared timer", to_string(_protocol).c_str());
+    }
+
     ESCState BLHeliESC::escState(void) const {
         switch (_state) {
             case BLHeliESCState::IdleFirstStart:
@@ -19,33 +34,131 @@ namespace pcp {
     void BLHeliESC::arm(Completion completion) {
         assert(_state == BLHeliESCState::IdleFirstStart || _state == BLHeliESCState::Idle);
 
+        if (_state == BLHeliESCState::IdleFirstStart) {
+            _loadCalibration();
+        }
+
         this->_state = BLHeliESCState::InPWMControlScheme;
-        _pwmControlScheme = std::make_unique<ESCControlSchemePWM<1000u, 2000u>>();
+        if (_pwmControlScheme == nullptr) {
+            _pwmControlScheme = _makeControlScheme();
+        }
+        _pwmControlScheme->setSetpointMode(_setpointMode);
         _pwmControlScheme->arm(completion);
     }
 
+    std::unique_ptr<ESCControlScheme> BLHeliESC::_makeControlScheme(void) const {
+        switch (_protocol) {
+            case ESCProtocol::PWM50:
+                return std::make_unique<ESCControlSchemePWM<ESCProtocol::PWM50>>(_sharedTimer, _outputGPIO, throttleEndpoints(), armProfile());
+            case ESCProtocol::PWM400:
+                return std::make_unique<ESCControlSchemePWM<ESCProtocol::PWM400>>(_sharedTimer, _outputGPIO, throttleEndpoints(), armProfile());
+            case ESCProtocol::OneShot125:
+                return std::make_unique<ESCControlSchemePWM<ESCProtocol::OneShot125>>(_sharedTimer, _outputGPIO, throttleEndpoints(), armProfile());
+            case ESCProtocol::OneShot42:
+                return std::make_unique<ESCControlSchemePWM<ESCProtocol::OneShot42>>(_sharedTimer, _outputGPIO, throttleEndpoints(), armProfile());
+            case ESCProtocol::Multishot:
+                return std::make_unique<ESCControlSchemePWM<ESCProtocol::Multishot>>(_sharedTimer, _outputGPIO, throttleEndpoints(), armProfile());
+            case ESCProtocol::DShot150:
+                return std::make_unique<ESCControlSchemeDShot<ESCProtocol::DShot150>>(_bidirectionalDShot, _motorPoles, _outputGPIO);
+            case ESCProtocol::DShot300:
+                return std::make_unique<ESCControlSchemeDShot<ESCProtocol::DShot300>>(_bidirectionalDShot, _motorPoles, _outputGPIO);
+            case ESCProtocol::DShot600:
+                return std::make_unique<ESCControlSchemeDShot<ESCProtocol::DShot600>>(_bidirectionalDShot, _motorPoles, _outputGPIO);
+        }
+        assert(false && "ESCProtocol case not handled in switch");
+        return nullptr;
+    }
+
+    // Only analog protocols need calibrating, and only the ESC on the programming UART can be asked for
+    // it.  The cache is tried first, and the bootloader only if that's empty, which costs a couple of
+    // seconds on the first boot with a new ESC.  A cached calibration is trusted until the bootloader is
+    // next entered, when _validateCalibration() checks it's for the same ESC.
+    void BLHeliESC::_loadCalibration(void) {
+        if (isDShot(_protocol) || _outputGPIO != kMotorOutputGPIO || _calibration.has_value()) {
+            return;
+        }
+
+        _calibration = cachedCalibrationForLastESC();
+        if (!_calibration.has_value()) {
+            _calibration = _readCalibration();
+        }
+        if (!_calibration.has_value()) {
+            PCP_LOGW("Couldn't read the ESC's calibration, using 1000-2000us and cold arming");
+            return;
+        }
+        PCP_LOGI("Using throttle endpoints %lld-%lldus", (long long)_calibration->throttleEndpoints.min.count(),
+                 (long long)_calibration->throttleEndpoints.max.count());
+    }
+
+    // Blocks while the ESC's settings are read through its bootloader, then starts its firmware again.
+    std::optional<BLHeliCalibration> BLHeliESC::_readCalibration(void) {
+        std::binary_semaphore connected(0);
+        _state = BLHeliESCState::InBootloaderUARTScheme;
+        _uartControlScheme = std::make_unique<BLHeliControlSchemeUART>();
+        _uartControlScheme->connect([&connected](bool success) { connected.release(); });
+
+        std::optional<BLHeliESCConfig> config;
+        if (connected.try_acquire_for(kEndpointReadTimeout)) {
+            config = _uartControlScheme->escConfig();
+        }
+        if (config.has_value()) {
+            _validateCalibration(config.value());
+            _uartControlScheme->runApplication();
+        }
+
+        // Deleting the scheme deletes its task, so the completion can't outlive connected.
+        _uartControlScheme = nullptr;
+        _state = BLHeliESCState::IdleFirstStart;
+        if (!config.has_value()) {
+            return std::optional<BLHeliCalibration>();
+        }
+        return BLHeliCalibration{.throttleEndpoints = config->throttleEndpoints(), .armProfile = config->armProfile(), .signature = config->deviceSignature()};
+    }
+
+    // A different signature from the cached one means the ESC has been swapped.  The last ESC's calibration
+    // is dropped, falling back to nominal endpoints, and this one's is cached in its place.
+    void BLHeliESC::_validateCalibration(const BLHeliESCConfig& config) {
+        const std::optional<BLHeliCalibration> cached = _calibration.has_value() ? _calibration : cachedCalibrationForLastESC();
+        const std::array<uint8_t, 2>& signature = config.deviceSignature();
+        if (cached.has_value() && cached->signature != signature) {
+            PCP_LOGW("ESC %02x%02x isn't the cached %02x%02x, dropping its calibration", signature[0], signature[1], cached->signature[0],
+                     cached->signature[1]);
+            invalidateCachedCalibrationForLastESC();
+            _calibration.reset();
+            _pwmControlScheme = nullptr;
+        }
+        cacheCalibration(config);
+    }
+
     void BLHeliESC::disarm(Completion completion) {
         assert(_state == BLHeliESCState::InPWMControlScheme);
 
-        _pwmControlScheme->disarm([this]() {
-            this->_pwmControlScheme = nullptr;
+        _pwmControlScheme->disarm([this, completion]() {
             _state = BLHeliESCState::Idle;
+            completion();
         });
     }
 
-    void BLHeliESC::setThrottle(uint8_t percentage, MsTime duration) {
+    void BLHeliESC::setSetpointMode(ESCSetpointMode mode) {
+        _setpointMode = mode;
+        if (_state == BLHeliESCState::InPWMControlScheme) {
+            _pwmControlScheme->setSetpointMode(mode);
+        }
+    }
+
+    void BLHeliESC::setThrottle(uint8_t percentage, UsTime duration) {
         assert(_state == BLHeliESCState::InPWMControlScheme);
 
         _pwmControlScheme->setThrottle(percentage, duration);
     }
 
-    void BLHeliESC::decreaseThrottle(int8_t percentage, MsTime duration) {
+    void BLHeliESC::decreaseThrottle(int8_t percentage, UsTime duration) {
         assert(_state == BLHeliESCState::InPWMControlScheme);
 
         _pwmControlScheme->decreaseThrottle(percentage, duration);
     }
 
-    void BLHeliESC::increaseThrottle(int8_t percentage, MsTime duration) {
+    void BLHeliESC::increaseThrottle(int8_t percentage, UsTime duration) {
         assert(_state == BLHeliESCState::InPWMControlScheme);
 
         _pwmControlScheme->increaseThrottle(percentage, duration);
@@ -67,15 +180,85 @@ namespace pcp {
         return std::optional<uint8_t>();
     }
 
+    std::optional<uint32_t> BLHeliESC::rpm() const {
+        if (_state != BLHeliESCState::InPWMControlScheme) {
+            return std::optional<uint32_t>();
+        }
+
+        return _pwmControlScheme->rpm();
+    }
+
+    bool BLHeliESC::engageFailsafeFromISR(uint8_t percentage) {
+        if (_state != BLHeliESCState::InPWMControlScheme) {
+            return false;
+        }
+
+        return _pwmControlScheme->engageFailsafeFromISR(percentage);
+    }
+
+    void BLHeliESC::releaseFailsafe(void) {
+        if (_state == BLHeliESCState::InPWMControlScheme) {
+            _pwmControlScheme->releaseFailsafe();
+        }
+    }
+
+    bool BLHeliESC::sendCommand(ESCCommand command, CommandCompletion completion) {
+        if (_state != BLHeliESCState::InPWMControlScheme) {
+            return false;
+        }
+
+        return _pwmControlScheme->sendCommand(command, completion);
+    }
+
     void BLHeliESC::enterProgrammingMode(std::function<void(std::optional<BLHeliESCConfig>)> completion) {
         assert(_state == BLHeliESCState::IdleFirstStart);
+        if (_outputGPIO != kMotorOutputGPIO) {
+            PCP_LOGE("Programming mode is only available for the ESC on the motor UART's GPIO");
+            completion(std::optional<BLHeliESCConfig>());
+            return;
+        }
 
         _state = BLHeliESCState::InBootloaderUARTScheme;
         _uartControlScheme = std::make_unique<BLHeliControlSchemeUART>();
-        _uartControlScheme->connect([this, completion](bool success) { completion(escConfig()); });
+        _uartControlScheme->connect([this, completion](bool success) {
+            std::optional<BLHeliESCConfig> config = escConfig();
+            if (config.has_value()) {
+                _validateCalibration(config.value());
+            }
+            completion(config);
+        });
     }
 
     std::optional<BLHeliESCConfig> BLHeliESC::escConfig(void) {
         return (_uartControlScheme == nullptr) ? std::optional<BLHeliESCConfig>() : _uartControlScheme->escConfig();
     }
+
+    bool BLHeliESC::backupFlash(BLHeliFlashBackupTarget target) {
+        const std::optional<BLHeliESCConfig> config = escConfig();
+        if (!config.has_value()) {
+            PCP_LOGE("Can only back up an ESC that's in programming mode");
+            return false;
+        }
+        return backupBLHeliFlash(*_uartControlScheme, config.value(), target);
+    }
+
+    bool BLHeliESC::writeConfig(const BLHeliESCConfig& config) {
+        if (!escConfig().has_value()) {
+            PCP_LOGE("Can only write settings to an ESC that's in programming mode");
+            return false;
+        }
+        if (!_flashBackedUp) {
+            if (!backupFlash(BLHeliFlashBackupTarget::Partition)) {
+                PCP_LOGE("Not writing settings to an ESC that couldn't be backed up");
+                return false;
+            }
+            _flashBackedUp = true;
+        }
+
+        if (!_uartControlScheme->writeConfig(config)) {
+            return false;
+        }
+        cacheCalibration(config);
+        return true;
+    }
 }  // namespace pcp
@@ -2,10 +2,14 @@
 
 #include "ESC/ESC.hpp"
 
+#include "ESC/BLHeli/BLHeliCalibrationCache.hpp"
 #include "ESC/BLHeli/BLHeliControlSchemeUART.hpp"
+#include "ESC/BLHeli/BLHeliFlashBackup.hpp"
+#include "ESC/ESCControlSchemeDShot.hpp"
 #include "ESC/ESCControlSchemePWM.hpp"
 
 #include <memory>
+#include <optional>
 
 namespace pcp {
     enum class BLHeliESCState {
@@ -17,21 +21,62 @@ namespace pcp {
 
     class BLHeliESC : public ESC {
     public:
+        // Bidirectional DShot and the motor pole count only apply to the DShot protocols.
+        BLHeliESC(ESCProtocol protocol = ESCProtocol::PWM50, bool bidirectionalDShot = false, uint8_t motorPoles = 14,
+                  gpio_num_t outputGPIO = kMotorOutputGPIO);
+        // One of several ESCs pulsing in phase off a shared timer, using the timer's protocol.
+        BLHeliESC(std::shared_ptr<ESCPWMTimer> sharedTimer, gpio_num_t outputGPIO);
+
         virtual ESCState escState(void) const override;
 
+        // The first arm of an analog ESC on kMotorOutputGPIO with no cached calibration blocks the calling task
+        // while it's read through the bootloader: up to kEndpointReadTimeout to connect, then the settings read.
         virtual void arm(Completion completion = []() {}) override;
         virtual void disarm(Completion completion = []() {}) override;
-        virtual void setThrottle(uint8_t percentage, MsTime duration = 0_ms) override;
-        virtual void decreaseThrottle(int8_t percentage, MsTime duration) override;
-        virtual void increaseThrottle(int8_t percentage, MsTime duration) override;
+        virtual void setSetpointMode(ESCSetpointMode mode) override;
+        virtual void setThrottle(uint8_t percentage, UsTime duration = 0_us) override;
+        virtual void decreaseThrottle(int8_t percentage, UsTime duration) override;
+        virtual void increaseThrottle(int8_t percentage, UsTime duration) override;
         virtual std::optional<uint8_t> throttle() const override;
+        virtual std::optional<uint32_t> rpm() const override;
+        virtual bool engageFailsafeFromISR(uint8_t percentage) override;
+        virtual void releaseFailsafe(void) override;
+
+        // Only digital protocols can send commands, returns false otherwise.
+        bool sendCommand(ESCCommand command, CommandCompletion completion = [](bool) {});
 
+        // Only available for the ESC on kMotorOutputGPIO, which is wired to the programming UART.
         void enterProgrammingMode(std::function<void(std::optional<BLHeliESCConfig>)> completion);
         std::optional<BLHeliESCConfig> escConfig(void);
+        // Needs the ESC in programming mode, and blocks for the few seconds reading the whole flash takes.
+        bool backupFlash(BLHeliFlashBackupTarget target);
+        // Writes whatever differs between config and the ESC's settings.  The ESC's flash is backed up to the
+        // backup partition before the first write of a programming session, and nothing's written without it.
+        bool writeConfig(const BLHeliESCConfig& config);
+
+        // Until the first arm these are the defaults, nominal 1-2ms endpoints and a conservative profile.
+        ESCThrottleEndpoints throttleEndpoints(void) const { return _calibration.has_value() ? _calibration->throttleEndpoints : ESCThrottleEndpoints{}; }
+        ESCArmProfile armProfile(void) const { return _calibration.has_value() ? _calibration->armProfile : ESCArmProfile{}; }
 
     private:
+        static constexpr MsTime kEndpointReadTimeout = 5000_ms;
+
+        std::unique_ptr<ESCControlScheme> _makeControlScheme(void) const;
+        void _loadCalibration(void);
+        std::optional<BLHeliCalibration> _readCalibration(void);
+        void _validateCalibration(const BLHeliESCConfig& config);
+
+        const ESCProtocol _protocol;
+        const bool _bidirectionalDShot;
+        const uint8_t _motorPoles;
+        const gpio_num_t _outputGPIO;
+        const std::shared_ptr<ESCPWMTimer> _sharedTimer;
+        ESCSetpointMode _setpointMode = ESCSetpointMode::Queued;
+        std::optional<BLHeliCalibration> _calibration;
         BLHeliESCState _state = BLHeliESCState::IdleFirstStart;
-        std::unique_ptr<ESCControlSchemePWM<1000u, 2000u>> _pwmControlScheme;
+        bool _flashBackedUp = false;
+        // Made on the first arm and kept, hardware and all, so re-arming is quick.
+        std::unique_ptr<ESCControlScheme> _pwmControlScheme;
         std::unique_ptr<BLHeliControlSchemeUART> _uartControlScheme;
     };
 }  // namespace pcp
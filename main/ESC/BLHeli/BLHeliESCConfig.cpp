@@ -636,6 +636,23 @@ namespace pcp {
         return eepromBytes[static_cast<size_t>(BLHeliESCSetting::LayoutRevision)] == 21;
     }
 
+    void BLHeliESCConfig::setSetting(BLHeliESCSetting setting, uint8_t value) {
+        assert(_settings.contains(setting));
+        _settings[setting] = value;
+    }
+
+    // Names shorter than the field are padded with spaces, as BLHeliSuite does.
+    std::array<uint8_t, kBLHeliEEPROMSize> BLHeliESCConfig::eepromBytes(void) const {
+        std::array<uint8_t, kBLHeliEEPROMSize> bytes = _eepromBytes;
+        for (const auto& [setting, value] : _settings) {
+            bytes[static_cast<size_t>(setting)] = value;
+        }
+        for (size_t i = 0; i < kBLHeliDeviceNameMaxLength; ++i) {
+            bytes[kBLHeliDeviceNameOffset + i] = i < _name.size() ? _name[i] : ' ';
+        }
+        return bytes;
+    }
+
     std::string BLHeliESCConfig::prettyLayout() const {
         static const std::unordered_map<std::string, std::string> kPrettyLayouts = {
             {"AIK_BL_30S", "AIKON Boltlite 30A"},
@@ -851,4 +868,27 @@ namespace pcp {
                 return BLHeliRotorType::Main;
         }
     }
+
+    ESCThrottleEndpoints BLHeliESCConfig::throttleEndpoints(void) const {
+        const auto settingValue = [this](BLHeliESCSetting setting) {
+            auto iter = _settings.find(setting);
+            return iter != _settings.end() ? iter->second : defaultValueForSetting(setting);
+        };
+        return ESCThrottleEndpoints{.min = UsTime(BLHeliThrottleValue(settingValue(BLHeliESCSetting::MinThrottlePpm)).ppm()),
+                                    .max = UsTime(BLHeliThrottleValue(settingValue(BLHeliESCSetting::MaxThrottlePpm)).ppm())};
+    }
+
+    // Multirotor firmware follows the throttle again as soon as it's seen zero.  Main and tail rotor
+    // firmware is slower to settle, so it's held at zero for longer and trusted to stay armed for less.
+    ESCArmProfile BLHeliESCConfig::armProfile(void) const {
+        switch (rotorType()) {
+            case BLHeliRotorType::Multi:
+                return ESCArmProfile{.coldStep = 500_ms, .warmHold = 300_ms, .warmWindow = 30'000_ms};
+            case BLHeliRotorType::Main:  // fallthrough
+            case BLHeliRotorType::Tail:
+                return ESCArmProfile{.coldStep = 500_ms, .warmHold = 1000_ms, .warmWindow = 5000_ms};
+        }
+        assert(false && "BLHeliRotorType case not handled in switch");
+        return ESCArmProfile{};
+    }
 }  // namespace pcp
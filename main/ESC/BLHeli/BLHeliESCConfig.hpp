@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ESC/ESCProtocol.hpp"
 #include "Utilities/Maths.hpp"
 
 #include <cstdint>
@@ -9,7 +10,12 @@
 #include <vector>
 
 namespace pcp {
+    static constexpr uint16_t kBLHeliEEPROMAddress = 0x1a00;
     static constexpr size_t kBLHeliEEPROMSize = 0x70;
+    // The firmware, its EEPROM and the bootloader all sit in the bottom 8KiB of the ESC's flash, which is
+    // erased a page at a time.
+    static constexpr uint32_t kBLHeliFlashSize = 0x2000;
+    static constexpr uint16_t kBLHeliFlashPageSize = 0x200;
 
     enum class BLHeliRotorType : uint8_t { Main = 0, Tail = 1, Multi = 2 };
 
@@ -310,8 +316,17 @@ namespace pcp {
 
         void setSetting(BLHeliESCSetting setting, uint8_t value);
 
+        // The EEPROM as it would be written, with the current settings and name.
+        std::array<uint8_t, kBLHeliEEPROMSize> eepromBytes(void) const;
+
         uint8_t defaultValueForSetting(BLHeliESCSetting setting) const;
 
+        // Where the ESC's throttle range sits, from its MinThrottlePpm and MaxThrottlePpm settings.
+        ESCThrottleEndpoints throttleEndpoints(void) const;
+
+        // How the firmware built for this layout wants to be armed.
+        ESCArmProfile armProfile(void) const;
+
     private:
         BLHeliESCConfig() = delete;
 
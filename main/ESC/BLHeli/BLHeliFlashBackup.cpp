@@ -0,0 +1,133 @@
+#include "ESC/BLHeli/BLHeliFlashBackup.hpp"
+
+#include "Log.hpp"
+
+#include "esp_crc.h"
+#include "esp_partition.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace pcp {
+    static constexpr const char* kBackupPartitionLabel = "esc_backup";
+    static constexpr uint32_t kBackupMagic = 0x46424350;
+    static constexpr size_t kHexRecordLength = 32;
+
+    // A slot is an image followed by a sector for its header.  The header is written last, so a backup that
+    // was cut short never looks like a good one.
+    static constexpr size_t kSectorSize = 0x1000;
+    static constexpr size_t kSlotSize = kBLHeliFlashSize + kSectorSize;
+
+    struct StoredBackupHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t length;
+        uint32_t crc;
+        std::array<uint8_t, 2> signature;
+        std::array<char, 18> layout;
+    };
+
+    static void printHexRecord(uint16_t address, uint8_t type, const uint8_t* bytes, size_t length) {
+        uint8_t checksum = length + (address >> 8) + (address & 0xff) + type;
+        printf(":%02X%04X%02X", (unsigned)length, (unsigned)address, (unsigned)type);
+        for (size_t i = 0; i < length; i++) {
+            printf("%02X", bytes[i]);
+            checksum += bytes[i];
+        }
+        printf("%02X\n", (unsigned)(uint8_t)-checksum);
+    }
+
+    static bool backupToConsole(BLHeliControlSchemeUART& uart, const BLHeliESCConfig& config) {
+        PCP_LOGI("Flash backup of %s follows as Intel HEX", config.prettyLayout().c_str());
+        const bool success = uart.dumpFlash(kBLHeliFlashSize, [](uint16_t address, const uint8_t* bytes, size_t length) {
+            for (size_t offset = 0; offset < length; offset += kHexRecordLength) {
+                printHexRecord(address + offset, 0x00, bytes + offset, std::min(kHexRecordLength, length - offset));
+            }
+            return true;
+        });
+        if (success) {
+            printHexRecord(0x0000, 0x01, nullptr, 0);
+        }
+        return success;
+    }
+
+    // The slot holding the oldest backup, or an empty one, and the sequence number the next backup gets.
+    static size_t nextSlot(const esp_partition_t* partition, uint32_t& sequence) {
+        size_t slot = 0;
+        uint32_t oldestSequence = UINT32_MAX;
+        sequence = 1;
+        for (size_t i = 0; i < partition->size / kSlotSize; i++) {
+            StoredBackupHeader header;
+            esp_err_t err = esp_partition_read(partition, i * kSlotSize + kBLHeliFlashSize, &header, sizeof(header));
+            const uint32_t slotSequence = (err == ESP_OK && header.magic == kBackupMagic) ? header.sequence : 0;
+            if (slotSequence < oldestSequence) {
+                oldestSequence = slotSequence;
+                slot = i;
+            }
+            sequence = std::max(sequence, slotSequence + 1);
+        }
+        return slot;
+    }
+
+    static bool backupToPartition(BLHeliControlSchemeUART& uart, const BLHeliESCConfig& config) {
+        const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, kBackupPartitionLabel);
+        if (partition == nullptr || partition->size < kSlotSize) {
+            PCP_LOGE("No %s partition big enough for a backup", kBackupPartitionLabel);
+            return false;
+        }
+
+        uint32_t sequence = 0;
+        const size_t slot = nextSlot(partition, sequence);
+        const size_t offset = slot * kSlotSize;
+        esp_err_t err = esp_partition_erase_range(partition, offset, kSlotSize);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error erasing backup slot: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        uint32_t crc = 0;
+        const bool success = uart.dumpFlash(kBLHeliFlashSize, [partition, offset, &crc](uint16_t address, const uint8_t* bytes, size_t length) {
+            crc = esp_crc32_le(crc, bytes, length);
+            esp_err_t err = esp_partition_write(partition, offset + address, bytes, length);
+            if (err != ESP_OK) {
+                PCP_LOGE("Error writing backup: %s", esp_err_to_name(err));
+                return false;
+            }
+            return true;
+        });
+        if (!success) {
+            return false;
+        }
+
+        StoredBackupHeader header = {
+            .magic = kBackupMagic,
+            .sequence = sequence,
+            .length = kBLHeliFlashSize,
+            .crc = crc,
+            .signature = config.deviceSignature(),
+            .layout = {},
+        };
+        strncpy(header.layout.data(), config.layout().c_str(), header.layout.size() - 1);
+        err = esp_partition_write(partition, offset + kBLHeliFlashSize, &header, sizeof(header));
+        if (err != ESP_OK) {
+            PCP_LOGE("Error writing backup header: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        PCP_LOGI("Backed up %s to slot %u", config.prettyLayout().c_str(), (unsigned)slot);
+        return true;
+    }
+
+    bool backupBLHeliFlash(BLHeliControlSchemeUART& uart, const BLHeliESCConfig& config, BLHeliFlashBackupTarget target) {
+        switch (target) {
+            case BLHeliFlashBackupTarget::Console:
+                return backupToConsole(uart, config);
+            case BLHeliFlashBackupTarget::Partition:
+                return backupToPartition(uart, config);
+        }
+        assert(false && "Unhandled case in switch statement");
+        return false;
+    }
+}  // namespace pcp
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ESC/BLHeli/BLHeliControlSchemeUART.hpp"
+#include "ESC/BLHeli/BLHeliESCConfig.hpp"
+
+namespace pcp {
+    enum class BLHeliFlashBackupTarget {
+        // Printed as Intel HEX, ready to be captured from the monitor and flashed back with the usual tools.
+        Console,
+        // Kept in the esc_backup partition, which holds the most recent backups and overwrites the oldest.
+        Partition,
+    };
+
+    // Dumps the whole of an ESC's flash through a scheme that's connected to its bootloader.
+    bool backupBLHeliFlash(BLHeliControlSchemeUART& uart, const BLHeliESCConfig& config, BLHeliFlashBackupTarget target);
+}  // namespace pcp
@@ -10,6 +10,7 @@
 namespace pcp {
     enum class BootloaderResultCode : uint8_t {
         ErrorTimeout = 0x01,
+        ErrorCollision = 0x02,
         Success = 0x30,
         ErrorVerify = 0xc0,
         ErrorCommand = 0xc1,
@@ -26,6 +27,8 @@ namespace pcp {
         switch (res) {
             case BootloaderResultCode::ErrorTimeout:
                 return "ErrorTimeout";
+            case BootloaderResultCode::ErrorCollision:
+                return "ErrorCollision";
             case BootloaderResultCode::Success:
                 return "Success";
             case BootloaderResultCode::ErrorVerify:
@@ -210,6 +213,28 @@ namespace pcp {
         size_t expectedReturnBytes(void) { return 0; }
     };
 
+    // Programs the buffer at the address, so needs a SetAddress and a SetBuffer first.
+    template <>
+    struct BootloaderCommand<BootloaderCommandType::ProgramFlash> {
+        static constexpr bool hasCommandData = true;
+        static constexpr bool hasArgument = false;
+        uint8_t commandData = 0x01;
+        using ReturnType = Void;
+
+        size_t expectedReturnBytes(void) { return 0; }
+    };
+
+    // Erases the page at the address.
+    template <>
+    struct BootloaderCommand<BootloaderCommandType::EraseFlash> {
+        static constexpr bool hasCommandData = true;
+        static constexpr bool hasArgument = false;
+        uint8_t commandData = 0x01;
+        using ReturnType = Void;
+
+        size_t expectedReturnBytes(void) { return 0; }
+    };
+
     template <>
     struct BootloaderCommand<BootloaderCommandType::ReadFlash> {
         static constexpr bool hasCommandData = true;
@@ -217,7 +242,8 @@ namespace pcp {
         uint8_t commandData = 0x00;
         using ReturnType = std::vector<uint8_t>;
 
-        size_t expectedReturnBytes(void) { return static_cast<size_t>(commandData); }
+        // A length of 0 reads a whole 256 byte block.
+        size_t expectedReturnBytes(void) { return commandData == 0 ? 256 : static_cast<size_t>(commandData); }
     };
 
     template <>
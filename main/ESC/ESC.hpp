@@ -1,6 +1,6 @@
 #pragma once
 
-#include "Utilities/MsTime.hpp"
+#include "Utilities/Time.hpp"
 
 #include <cstdint>
 #include <functional>
@@ -9,6 +9,8 @@
 
 namespace pcp {
     using Completion = std::function<void(void)>;
+    // Told whether the command actually went out, which may only be known once it reaches the front of the queue.
+    using CommandCompletion = std::function<void(bool)>;
 
     enum class ESCState : uint8_t {
         Disarmed = 0,
@@ -34,6 +36,20 @@ namespace pcp {
         }
     }
 
+    // How throttle changes are scheduled.  Queued plays every change out in order, one after another.
+    // LatestWins keeps a single pending target which each new change replaces, ramping from wherever the
+    // output is when it's picked up; memory use and latency stay constant however often it's called.
+    // Preempt queues like Queued, but a new change cancels any earlier change still playing or waiting
+    // and starts from the current output.  PreemptSmooth also carries the cancelled ramp's velocity into
+    // the new one and eases into the target, so the motor never sees a step in speed.
+    // Arm and disarm sequences are always queued and never preempted.
+    enum class ESCSetpointMode : uint8_t {
+        Queued = 0,
+        LatestWins = 1,
+        Preempt = 2,
+        PreemptSmooth = 3,
+    };
+
     class ESC {
     public:
         virtual bool isArmed(void) const {
@@ -45,10 +61,17 @@ namespace pcp {
 
         virtual void arm(Completion completion = []() {}) = 0;
         virtual void disarm(Completion completion = []() {}) = 0;
-        virtual void setThrottle(uint8_t percentage, MsTime duration = 0_ms) = 0;
-        virtual void decreaseThrottle(int8_t percentage, MsTime duration) = 0;
-        virtual void increaseThrottle(int8_t percentage, MsTime duration) = 0;
+        virtual void setSetpointMode(ESCSetpointMode mode) {}
+        virtual void setThrottle(uint8_t percentage, UsTime duration = 0_us) = 0;
+        virtual void decreaseThrottle(int8_t percentage, UsTime duration) = 0;
+        virtual void increaseThrottle(int8_t percentage, UsTime duration) = 0;
         virtual std::optional<uint8_t> throttle() const = 0;
+        // The measured motor speed, if the ESC is reporting one.
+        virtual std::optional<uint32_t> rpm() const { return std::optional<uint32_t>(); }
+        // Holds the output at percentage, overriding throttle changes, until releaseFailsafe().  Only acts
+        // while armed, and is safe to call from an ISR; returns true if a higher priority task was woken.
+        virtual bool engageFailsafeFromISR(uint8_t percentage) { return false; }
+        virtual void releaseFailsafe(void) {}
 
         virtual std::string stateString(void) const {
             switch (escState()) {
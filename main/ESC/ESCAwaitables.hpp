@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ESC/ESC.hpp"
+#include "Utilities/Async.hpp"
+#include "Utilities/Void.hpp"
+
+namespace pcp {
+    // co_await armAsync(esc, executor) resumes on executor once the ESC is armed.
+    inline auto armAsync(ESC& esc, CoroutineExecutor& executor) {
+        return awaitCompletion<Void>(executor, [&esc](auto* awaitable) { esc.arm([awaitable]() { awaitable->complete(Void()); }); });
+    }
+
+    inline auto disarmAsync(ESC& esc, CoroutineExecutor& executor) {
+        return awaitCompletion<Void>(executor, [&esc](auto* awaitable) { esc.disarm([awaitable]() { awaitable->complete(Void()); }); });
+    }
+}  // namespace pcp
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ESC/ESC.hpp"
+#include "Utilities/Time.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace pcp {
+    // Commands that digital protocols can send to the ESC in place of a throttle value.
+    enum class ESCCommand : uint8_t {
+        Beep1,
+        Beep2,
+        Beep3,
+        Beep4,
+        Beep5,
+        SpinDirectionNormal,
+        SpinDirectionReversed,
+        SaveSettings,
+    };
+
+    // The throttle control surface that an ESC forwards to whichever signalling scheme it's using.
+    class ESCControlScheme {
+    public:
+        virtual ~ESCControlScheme() {}
+
+        virtual bool isArmed(void) const = 0;
+        virtual ESCState escState(void) const = 0;
+
+        virtual void arm(Completion completion = []() {}) = 0;
+        virtual void disarm(Completion completion = []() {}) = 0;
+        // Schemes that don't support a mode ignore it and keep queuing.
+        virtual void setSetpointMode(ESCSetpointMode mode) {}
+        virtual void setThrottle(int8_t percentage, UsTime duration = 0_us) = 0;
+        virtual void decreaseThrottle(int8_t percentage, UsTime duration) = 0;
+        virtual void increaseThrottle(int8_t percentage, UsTime duration) = 0;
+        virtual uint8_t throttle() const = 0;
+        virtual std::optional<uint32_t> rpm() const { return std::optional<uint32_t>(); }
+        virtual bool engageFailsafeFromISR(uint8_t percentage) { return false; }
+        virtual void releaseFailsafe(void) {}
+
+        virtual std::string stateString(void) const = 0;
+
+        // Returns false if the scheme has no way to send commands.
+        virtual bool sendCommand(ESCCommand command, CommandCompletion completion = [](bool) {}) { return false; }
+    };
+}  // namespace pcp
@@ -0,0 +1,751 @@
+#pragma once
+
+#include "ESCControlScheme.hpp"
+#include "ESCOperation.hpp"
+#include "ESCProtocol.hpp"
+#include "Log.hpp"
+#include "Pins.hpp"
+#include "Utilities/FixedVector.hpp"
+#include "Utilities/Maths.hpp"
+#include "Utilities/Time.hpp"
+#include "Utilities/freeRTOSErrorString.hpp"
+
+#include "driver/gpio.h"
+#include "driver/rmt_encoder.h"
+#include "driver/rmt_rx.h"
+#include "driver/rmt_tx.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace pcp {
+    // DShot throttle steps: 0 stops the motor, 1...kDShotMaxThrottle map onto DShot values 48...2047.
+    using DShotThrottle = int32_t;
+
+    static constexpr DShotThrottle kDShotMaxThrottle = 2000;
+    static constexpr uint16_t kDShotMinThrottleValue = 48;
+
+    constexpr uint16_t dshotValueForThrottle(DShotThrottle throttle) {
+        return throttle <= 0 ? 0 : static_cast<uint16_t>(kDShotMinThrottleValue - 1 + std::min(throttle, kDShotMaxThrottle));
+    }
+
+    constexpr uint16_t dshotValueForCommand(ESCCommand command) {
+        switch (command) {
+            case ESCCommand::Beep1: return 1;
+            case ESCCommand::Beep2: return 2;
+            case ESCCommand::Beep3: return 3;
+            case ESCCommand::Beep4: return 4;
+            case ESCCommand::Beep5: return 5;
+            case ESCCommand::SpinDirectionNormal: return 20;
+            case ESCCommand::SpinDirectionReversed: return 21;
+            case ESCCommand::SaveSettings: return 12;
+        }
+        return 0;
+    }
+
+    // An 11 bit value, a telemetry request bit and a 4 bit checksum of the first 12 bits.  Bidirectional
+    // DShot inverts the checksum so ESCs can tell which kind of frame they're being sent.
+    constexpr uint16_t dshotPacket(uint16_t value, bool telemetry, bool bidirectional = false) {
+        const uint16_t data = static_cast<uint16_t>((value << 1) | (telemetry ? 1 : 0));
+        const uint16_t crc = (data ^ (data >> 4) ^ (data >> 8) ^ (bidirectional ? 0x0f : 0)) & 0x0f;
+        return static_cast<uint16_t>((data << 4) | crc);
+    }
+
+    static_assert(dshotPacket(1046, false) == 0x82c6, "DShot packet encoding doesn't match the specification's example");
+
+    // Maps 5 bit GCR codes back to nibbles, 0xff for codes that are never sent.
+    static constexpr std::array<uint8_t, 32> kDShotGCRDecodeTable = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x09, 0x0a, 0x0b, 0xff, 0x0d, 0x0e, 0x0f,
+        0xff, 0xff, 0x02, 0x03, 0xff, 0x05, 0x06, 0x07, 0xff, 0x00, 0x08, 0x01, 0xff, 0x04, 0x0c, 0xff,
+    };
+
+    // Decodes a bidirectional DShot reply from the runs of levels the RMT captured.  Each edge is a one
+    // and every extra bit period without an edge is a zero; XORing those 21 bits with themselves shifted
+    // gives 20 bits of GCR encoded data holding the eRPM period and a checksum.  On success outPeriodUs is
+    // the electrical revolution period in microseconds, or 0 if the motor is stopped.
+    inline bool decodeDShotReply(const rmt_symbol_word_t* symbols, size_t symbolCount, uint32_t replyBitTicks, uint32_t replyBits,
+                                 uint32_t& outPeriodUs) {
+        uint32_t value = 0;
+        uint32_t bits = 0;
+        for (size_t i = 0; i < symbolCount * 2 && bits < replyBits; ++i) {
+            const rmt_symbol_word_t& symbol = symbols[i / 2];
+            const uint32_t duration = (i % 2 == 0) ? symbol.duration0 : symbol.duration1;
+            if (duration == 0) {
+                break;
+            }
+
+            const uint32_t runBits = (duration + replyBitTicks / 2) / replyBitTicks;
+            if (runBits == 0 || bits + runBits > replyBits) {
+                return false;
+            }
+            value = (value << runBits) | (1u << (runBits - 1));
+            bits += runBits;
+        }
+
+        // The last run merges into the idle level, so it's however many bits are left.
+        if (bits < replyBits) {
+            const uint32_t runBits = replyBits - bits;
+            value = (value << runBits) | (1u << (runBits - 1));
+        }
+
+        const uint32_t gcr = value ^ (value >> 1);
+        uint32_t decoded = 0;
+        for (uint32_t nibble = 0; nibble < 4; ++nibble) {
+            const uint8_t decodedNibble = kDShotGCRDecodeTable[(gcr >> (nibble * 5)) & 0x1f];
+            if (decodedNibble == 0xff) {
+                return false;
+            }
+            decoded |= static_cast<uint32_t>(decodedNibble) << (nibble * 4);
+        }
+
+        uint32_t checksum = decoded ^ (decoded >> 8);
+        checksum ^= checksum >> 4;
+        if ((checksum & 0x0f) != 0x0f) {
+            return false;
+        }
+
+        // 3 bits of left shift and 9 bits of period.
+        const uint32_t eRPMPeriod = decoded >> 4;
+        outPeriodUs = eRPMPeriod == 0x0fff ? 0 : (eRPMPeriod & 0x1ff) << (eRPMPeriod >> 9);
+        return true;
+    }
+
+    template <ESCProtocol protocol = ESCProtocol::DShot300>
+    class ESCControlSchemeDShot : public ESCControlScheme {
+        static_assert(isDShot(protocol), "ESCControlSchemeDShot only drives DShot protocols");
+
+    public:
+        using Timing = DShotTiming<protocol>;
+
+        // Bidirectional DShot needs ESC firmware that supports it (e.g. Bluejay or BLHeli_32), and the motor's
+        // pole count to turn the reported electrical RPM into an actual RPM.
+        ESCControlSchemeDShot(bool bidirectional = false, uint8_t motorPoles = 14, gpio_num_t outputGPIO = kMotorOutputGPIO);
+        virtual ~ESCControlSchemeDShot();
+
+        virtual bool isArmed(void) const override;
+
+        virtual ESCState escState(void) const override { return _state; }
+
+        virtual void arm(Completion completion = []() {}) override;
+        virtual void disarm(Completion completion = []() {}) override;
+        // The task already ramps from wherever the output is, so LatestWins behaves like Preempt.
+        virtual void setSetpointMode(ESCSetpointMode mode) override { _setpointMode = mode; }
+        virtual void setThrottle(int8_t percentage, UsTime duration = 0_us) override;
+        virtual void decreaseThrottle(int8_t percentage, UsTime duration) override;
+        virtual void increaseThrottle(int8_t percentage, UsTime duration) override;
+        virtual uint8_t throttle() const override;
+        virtual std::optional<uint32_t> rpm() const override;
+        virtual bool engageFailsafeFromISR(uint8_t percentage) override;
+        virtual void releaseFailsafe(void) override;
+
+        virtual std::string stateString(void) const override;
+
+        virtual bool sendCommand(ESCCommand command, CommandCompletion completion = [](bool) {}) override;
+
+    private:
+        static constexpr size_t kSymbolsPerFrame = Timing::kBitsPerFrame + 1;
+        // Settings commands are only acted upon once they've been received several times in a row.
+        static constexpr size_t kCommandRepeats = 10;
+        // Replies are a few symbols long, anything bigger is our own frame being looped back.
+        static constexpr size_t kReceiveSymbols = SOC_RMT_MEM_WORDS_PER_CHANNEL;
+        static constexpr size_t kMaxReplySymbols = (Timing::kReplyBits + 1) / 2;
+        static constexpr UsTime kTelemetryTimeout = 100_ms;
+        static constexpr size_t kOperationQueueCapacity = 8;
+
+        struct QueuedOperation {
+            ESCOperation<DShotThrottle> operation;
+            std::optional<ESCCommand> command;
+            Completion completion;
+        };
+
+        void _encodeFrame(uint16_t packet, rmt_symbol_word_t* outSymbols) const;
+
+        ESCOperation<DShotThrottle> _changeThrottleOp(int8_t percentage, UsTime duration) const;
+        void _runOperation(QueuedOperation&& op);
+        void _preemptThrottle(DShotThrottle target, UsTime duration);
+
+        void _setupChannel(void);
+        void _setupReceiveChannel(void);
+        bool _receiveReply(const rmt_rx_done_event_data_t* edata);
+        void _startReceiving(void);
+
+        TickType_t _serviceOperationQueue(void);
+        void _transmitThrottle(DShotThrottle throttle);
+        bool _transmitCommand(ESCCommand command);
+
+        DShotThrottle _lastQueuedThrottle(void) const;
+        DShotThrottle _lastQueuedThrottleLocked(void) const;
+
+        template <ESCProtocol p>
+        friend void _dshotUpdateTask(void* userInfo);
+        template <ESCProtocol p>
+        friend bool _dshotReceiveDone(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* edata, void* userInfo);
+
+        const bool _bidirectional;
+        const uint8_t _motorPoles;
+        const gpio_num_t _outputGPIO;
+
+        rmt_channel_handle_t _channelHandle = nullptr;
+        rmt_encoder_handle_t _encoderHandle = nullptr;
+        bool _channelEnabled = false;
+        std::array<rmt_symbol_word_t, kSymbolsPerFrame> _frameSymbols{};
+        std::array<rmt_symbol_word_t, kSymbolsPerFrame * kCommandRepeats> _commandSymbols{};
+        DShotThrottle _throttle = 0;
+        std::optional<DShotThrottle> _transmittedThrottle;
+        ESCState _state = ESCState::Disarmed;
+        ESCSetpointMode _setpointMode = ESCSetpointMode::Queued;
+        // While non-negative, the task sends this and leaves the queue alone.
+        std::atomic<DShotThrottle> _failsafeThrottle = -1;
+
+        // The receive buffer is reused for every reply, and decoded in place by the receive ISR.
+        rmt_channel_handle_t _receiveChannelHandle = nullptr;
+        std::array<rmt_symbol_word_t, kReceiveSymbols> _receiveSymbols{};
+        std::atomic<uint32_t> _eRPMPeriodUs = 0;
+        std::atomic<WrappingUsTimestamp> _lastReplyTime = 0;
+        std::atomic<bool> _hasReply = false;
+
+        mutable std::mutex _operationQueueMutex;
+        FixedVector<QueuedOperation, kOperationQueueCapacity> _operationQueue;
+        bool _frontOperationStarted = false;
+        EspTimerClock::time_point _frontOperationStart;
+        ESCOperationCursor<DShotThrottle> _operationCursor;
+        // Whether the command that started last went out, for its completion.  Only the task touches it.
+        bool _lastCommandSent = false;
+        TaskHandle_t _updateTask = nullptr;
+        SemaphoreHandle_t _taskSemaphore = nullptr;
+    };
+
+    static constexpr MsTime kDShotArmDuration = 1500_ms;
+    static constexpr MsTime kDShotDisarmDuration = 500_ms;
+
+    template <ESCProtocol protocol>
+    void _dshotUpdateTask(void* userInfo);
+
+    template <ESCProtocol protocol>
+    bool _dshotReceiveDone(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* edata, void* userInfo);
+
+    template <ESCProtocol protocol>
+    ESCControlSchemeDShot<protocol>::ESCControlSchemeDShot(bool bidirectional, uint8_t motorPoles, gpio_num_t outputGPIO)
+        : _bidirectional(bidirectional), _motorPoles(std::max<uint8_t>(2, motorPoles)), _outputGPIO(outputGPIO) {
+        _setupChannel();
+        if (_bidirectional) {
+            _setupReceiveChannel();
+        }
+        _taskSemaphore = xQueueGenericCreate((UBaseType_t)1, semSEMAPHORE_QUEUE_ITEM_LENGTH, queueQUEUE_TYPE_BINARY_SEMAPHORE);
+        BaseType_t err = xTaskCreate(_dshotUpdateTask<protocol>, "DShot Update Task", 8192, this, 10, &_updateTask);
+        if (err != pdPASS) {
+            PCP_LOGE("Motor task creation failed: %s", freeRTOSErrorString(err));
+        }
+    }
+
+    template <ESCProtocol protocol>
+    ESCControlSchemeDShot<protocol>::~ESCControlSchemeDShot() {
+        vTaskDelete(_updateTask);
+        vSemaphoreDelete(_taskSemaphore);
+
+        if (_channelEnabled) {
+            rmt_disable(_channelHandle);
+        }
+        rmt_del_encoder(_encoderHandle);
+        rmt_del_channel(_channelHandle);
+
+        if (_receiveChannelHandle != nullptr) {
+            rmt_disable(_receiveChannelHandle);
+            rmt_del_channel(_receiveChannelHandle);
+        }
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_encodeFrame(uint16_t packet, rmt_symbol_word_t* outSymbols) const {
+        for (size_t bit = 0; bit < Timing::kBitsPerFrame; ++bit) {
+            const bool one = (packet & (0x8000 >> bit)) != 0;
+            const uint32_t highTicks = one ? Timing::kOneHighTicks : Timing::kZeroHighTicks;
+            outSymbols[bit].level0 = 1;
+            outSymbols[bit].duration0 = highTicks;
+            outSymbols[bit].level1 = 0;
+            outSymbols[bit].duration1 = Timing::kBitTicks - highTicks;
+        }
+
+        const uint32_t gapTicks = _bidirectional ? Timing::kBidirectionalFrameGapTicks : Timing::kFrameGapTicks;
+        rmt_symbol_word_t& gap = outSymbols[Timing::kBitsPerFrame];
+        gap.level0 = 0;
+        gap.duration0 = gapTicks / 2;
+        gap.level1 = 0;
+        gap.duration1 = gapTicks - gapTicks / 2;
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_setupChannel(void) {
+        esp_err_t err = ESP_OK;
+
+        rmt_tx_channel_config_t channelConfig = {.gpio_num = _outputGPIO,
+                                                 .clk_src = RMT_CLK_SRC_DEFAULT,
+                                                 .resolution_hz = Timing::kResolutionHz,
+                                                 .mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+                                                 .trans_queue_depth = 4,
+                                                 .intr_priority = 0,
+                                                 .flags = {
+                                                     .invert_out = _bidirectional,
+                                                     .with_dma = false,
+                                                     .io_loop_back = _bidirectional,
+                                                     .io_od_mode = _bidirectional,
+                                                     .allow_pd = false,
+                                                 }};
+        err = rmt_new_tx_channel(&channelConfig, &_channelHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while creating RMT channel: %s", esp_err_to_name(err));
+            return;
+        }
+
+        rmt_copy_encoder_config_t encoderConfig = {};
+        err = rmt_new_copy_encoder(&encoderConfig, &_encoderHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while creating RMT encoder: %s", esp_err_to_name(err));
+            return;
+        }
+    }
+
+    // Bidirectional DShot idles high, with the ESC pulling the line low to reply, so the transmitter is
+    // open drain and the receiver listens on the same pin.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_setupReceiveChannel(void) {
+        esp_err_t err = ESP_OK;
+
+        rmt_rx_channel_config_t channelConfig = {.gpio_num = _outputGPIO,
+                                                 .clk_src = RMT_CLK_SRC_DEFAULT,
+                                                 .resolution_hz = Timing::kResolutionHz,
+                                                 .mem_block_symbols = kReceiveSymbols,
+                                                 .intr_priority = 0,
+                                                 .flags = {
+                                                     .invert_in = false,
+                                                     .with_dma = false,
+                                                     .io_loop_back = false,
+                                                     .allow_pd = false,
+                                                 }};
+        err = rmt_new_rx_channel(&channelConfig, &_receiveChannelHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while creating RMT receive channel: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = gpio_pullup_en(_outputGPIO);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while enabling pull up on motor GPIO: %s", esp_err_to_name(err));
+            return;
+        }
+
+        rmt_rx_event_callbacks_t callbacks = {.on_recv_done = _dshotReceiveDone<protocol>};
+        err = rmt_rx_register_event_callbacks(_receiveChannelHandle, &callbacks, this);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while setting up RMT receive callbacks: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = rmt_enable(_receiveChannelHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while enabling RMT receive channel: %s", esp_err_to_name(err));
+            return;
+        }
+
+        _startReceiving();
+    }
+
+    // A reception ends once the line has been idle for a few reply bits, which splits our own looped back
+    // frame and the ESC's reply into separate receptions.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_startReceiving(void) {
+        rmt_receive_config_t receiveConfig = {.signal_range_min_ns = 200,
+                                              .signal_range_max_ns = Timing::kReplyBitNs * 5,
+                                              .flags = {
+                                                  .en_partial_rx = false,
+                                              }};
+        esp_err_t err = rmt_receive(_receiveChannelHandle, _receiveSymbols.data(), sizeof(_receiveSymbols), &receiveConfig);
+        if (err != ESP_OK) {
+            PCP_DRAM_LOGE("Error occurred while starting RMT receive: %s", esp_err_to_name(err));
+        }
+    }
+
+    // Called from the RMT receive ISR.  Decoding a reply is a few dozen integer operations, far cheaper
+    // than waking a task at the frame rate would be.
+    template <ESCProtocol protocol>
+    bool ESCControlSchemeDShot<protocol>::_receiveReply(const rmt_rx_done_event_data_t* edata) {
+        uint32_t periodUs = 0;
+        if (edata->num_symbols <= kMaxReplySymbols &&
+            decodeDShotReply(edata->received_symbols, edata->num_symbols, Timing::kReplyBitTicks, Timing::kReplyBits, periodUs)) {
+            _eRPMPeriodUs.store(periodUs, std::memory_order_relaxed);
+            _lastReplyTime.store(wrappingUsTimestamp(EspTimerClock::now()), std::memory_order_relaxed);
+            _hasReply.store(true, std::memory_order_release);
+        }
+
+        _startReceiving();
+        return false;
+    }
+
+    // Looping frames are replayed from the channel's own memory, so once this returns the CPU isn't
+    // involved again until the throttle changes.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_transmitThrottle(DShotThrottle throttle) {
+        _throttle = std::clamp(throttle, (DShotThrottle)0, kDShotMaxThrottle);
+        if (isArmed()) {
+            _state = _throttle == 0 ? ESCState::Armed : ESCState::Running;
+        }
+
+        if (_channelHandle == nullptr || (_transmittedThrottle.has_value() && _transmittedThrottle.value() == _throttle)) {
+            return;
+        }
+
+        esp_err_t err = ESP_OK;
+        if (_channelEnabled) {
+            err = rmt_disable(_channelHandle);
+            if (err != ESP_OK) {
+                PCP_LOGE("Error occurred while stopping RMT channel: %s", esp_err_to_name(err));
+                return;
+            }
+            _channelEnabled = false;
+        }
+
+        _encodeFrame(dshotPacket(dshotValueForThrottle(_throttle), false, _bidirectional), _frameSymbols.data());
+
+        err = rmt_enable(_channelHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while enabling RMT channel: %s", esp_err_to_name(err));
+            return;
+        }
+        _channelEnabled = true;
+
+        rmt_transmit_config_t transmitConfig = {.loop_count = -1, .flags = {.eot_level = 0, .queue_nonblocking = false}};
+        err = rmt_transmit(_channelHandle, _encoderHandle, _frameSymbols.data(), sizeof(_frameSymbols), &transmitConfig);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while transmitting DShot frame: %s", esp_err_to_name(err));
+            return;
+        }
+        _transmittedThrottle = _throttle;
+    }
+
+    template <ESCProtocol protocol>
+    bool ESCControlSchemeDShot<protocol>::_transmitCommand(ESCCommand command) {
+        if (_channelHandle == nullptr || !_channelEnabled) {
+            PCP_LOGW("DShot commands need the ESC armed");
+            return false;
+        }
+        if (_throttle != 0) {
+            PCP_LOGW("DShot commands are ignored while the motor is running");
+            return false;
+        }
+
+        esp_err_t err = rmt_disable(_channelHandle);
+        if (err == ESP_OK) {
+            err = rmt_enable(_channelHandle);
+        }
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while restarting RMT channel: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        const uint16_t packet = dshotPacket(dshotValueForCommand(command), true, _bidirectional);
+        for (size_t i = 0; i < kCommandRepeats; ++i) {
+            _encodeFrame(packet, _commandSymbols.data() + i * kSymbolsPerFrame);
+        }
+
+        rmt_transmit_config_t transmitConfig = {.loop_count = 0, .flags = {.eot_level = 0, .queue_nonblocking = false}};
+        err = rmt_transmit(_channelHandle, _encoderHandle, _commandSymbols.data(), sizeof(_commandSymbols), &transmitConfig);
+        if (err == ESP_OK) {
+            err = rmt_tx_wait_all_done(_channelHandle, -1);
+        }
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while transmitting DShot command: %s", esp_err_to_name(err));
+        }
+
+        _transmittedThrottle.reset();
+        _transmitThrottle(_throttle);
+        return err == ESP_OK;
+    }
+
+    // Plays out the queued operations, returning how long the task can sleep before the output next
+    // changes.
+    template <ESCProtocol protocol>
+    TickType_t ESCControlSchemeDShot<protocol>::_serviceOperationQueue(void) {
+        const DShotThrottle failsafeThrottle = _failsafeThrottle.load(std::memory_order_relaxed);
+        if (failsafeThrottle >= 0) {
+            _transmitThrottle(failsafeThrottle);
+            return portMAX_DELAY;
+        }
+
+        while (true) {
+            Completion completion;
+            {
+                std::lock_guard<std::mutex> guard(_operationQueueMutex);
+                if (_operationQueue.empty()) {
+                    return portMAX_DELAY;
+                }
+
+                QueuedOperation& front = _operationQueue.front();
+                if (!_frontOperationStarted) {
+                    _frontOperationStarted = true;
+                    _frontOperationStart = EspTimerClock::now();
+                    _operationCursor = ESCOperationCursor<DShotThrottle>(front.operation);
+                    if (front.command.has_value()) {
+                        _lastCommandSent = _transmitCommand(front.command.value());
+                    }
+                }
+
+                const ESCOperation<DShotThrottle>& operation = front.operation;
+                if (!operation.empty()) {
+                    const UsTime time = EspTimerClock::now() - _frontOperationStart;
+                    if (!_operationCursor.finished(time)) {
+                        UsTime nextChange;
+                        _transmitThrottle(_operationCursor.at(time, nextChange));
+                        return std::max<TickType_t>(1, ticksToWait(nextChange - time));
+                    }
+                    _transmitThrottle(operation._speeds.back().second);
+                }
+
+                completion = std::move(front.completion);
+                _operationQueue.pop_front();
+                _frontOperationStarted = false;
+            }
+
+            if (completion) {
+                completion();
+            }
+        }
+    }
+
+    template <ESCProtocol protocol>
+    uint8_t ESCControlSchemeDShot<protocol>::throttle() const {
+        return invLerpPercentage(_throttle, (DShotThrottle)0, kDShotMaxThrottle);
+    }
+
+    template <ESCProtocol protocol>
+    std::optional<uint32_t> ESCControlSchemeDShot<protocol>::rpm() const {
+        if (!_hasReply.load(std::memory_order_acquire)) {
+            return std::optional<uint32_t>();
+        }
+
+        const WrappingUsTimestamp now = wrappingUsTimestamp(EspTimerClock::now());
+        if (wrappingUsElapsed(_lastReplyTime.load(std::memory_order_relaxed), now) > kTelemetryTimeout) {
+            return std::optional<uint32_t>();
+        }
+
+        const uint32_t periodUs = _eRPMPeriodUs.load(std::memory_order_relaxed);
+        if (periodUs == 0) {
+            return 0;
+        }
+        return (60'000'000 / periodUs) / (_motorPoles / 2);
+    }
+
+    // The update task wakes straight away to send the failsafe throttle.
+    template <ESCProtocol protocol>
+    bool ESCControlSchemeDShot<protocol>::engageFailsafeFromISR(uint8_t percentage) {
+        if (!isArmed()) {
+            return false;
+        }
+
+        _failsafeThrottle.store(lerpPercentage((DShotThrottle)0, kDShotMaxThrottle, std::min<uint8_t>(percentage, 100)), std::memory_order_relaxed);
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        xSemaphoreGiveFromISR(_taskSemaphore, &higherPriorityTaskWoken);
+        return higherPriorityTaskWoken == pdTRUE;
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::releaseFailsafe(void) {
+        _failsafeThrottle.store(-1, std::memory_order_relaxed);
+        xSemaphoreGive(_taskSemaphore);
+    }
+
+    template <ESCProtocol protocol>
+    std::string ESCControlSchemeDShot<protocol>::stateString(void) const {
+        switch (escState()) {
+            case ESCState::Disarmed: return "Disarmed";
+            case ESCState::Arming: return "Arming...";
+            case ESCState::Armed:  // fallthrough
+            case ESCState::Running: return std::to_string(throttle()) + "%";
+            case ESCState::Disarming: return "Disarming...";
+            default: break;
+        }
+        assert(false && "Unhandled ESC state");
+        return "";
+    }
+
+    template <ESCProtocol protocol>
+    bool ESCControlSchemeDShot<protocol>::isArmed(void) const {
+        return _state == ESCState::Armed || _state == ESCState::Running;
+    }
+
+    // ESCs arm once they've seen a steady stream of zero throttle frames.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::arm(Completion completion) {
+        assert(_state == ESCState::Disarmed);
+
+        _state = ESCState::Arming;
+        _runOperation({ESCOperation<DShotThrottle>("Arm", {{0_us, 0}, {kDShotArmDuration, 0}}), std::nullopt, [this, completion]() {
+                           this->_state = this->_throttle == 0 ? ESCState::Armed : ESCState::Running;
+                           completion();
+                       }});
+    }
+
+    // Once the motor has stopped the frames stop too, and the ESC disarms itself on signal loss.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::disarm(Completion completion) {
+        releaseFailsafe();
+        _state = ESCState::Disarming;
+        const DShotThrottle lastThrottle = _lastQueuedThrottle();
+        _runOperation({ESCOperation<DShotThrottle>("Disarm", {{0_us, lastThrottle}, {kDShotDisarmDuration, 0}}), std::nullopt, [this, completion]() {
+                           this->_state = ESCState::Disarmed;
+                           if (this->_channelEnabled) {
+                               esp_err_t err = rmt_disable(this->_channelHandle);
+                               if (err != ESP_OK) {
+                                   PCP_LOGE("Error occurred while stopping RMT channel: %s", esp_err_to_name(err));
+                                   return;
+                               }
+                               this->_channelEnabled = false;
+                               this->_transmittedThrottle.reset();
+                           }
+                           completion();
+                       }});
+    }
+
+    template <ESCProtocol protocol>
+    bool ESCControlSchemeDShot<protocol>::sendCommand(ESCCommand command, CommandCompletion completion) {
+        _runOperation({ESCOperation<DShotThrottle>("Command", {}), command, [this, completion]() { completion(this->_lastCommandSent); }});
+        return true;
+    }
+
+    template <ESCProtocol protocol>
+    ESCOperation<DShotThrottle> ESCControlSchemeDShot<protocol>::_changeThrottleOp(int8_t percentage, UsTime duration) const {
+        const DShotThrottle lastThrottle = _lastQueuedThrottle();
+        const DShotThrottle newThrottle = std::clamp(lastThrottle + ((int32_t)percentage * kDShotMaxThrottle) / 100, (DShotThrottle)0, kDShotMaxThrottle);
+        return ESCOperation<DShotThrottle>("Change Throttle", {{0_us, lastThrottle}, {duration, newThrottle}}).withEasing(ESCEasing::Smoothstep);
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::setThrottle(int8_t percentage, UsTime duration) {
+        const DShotThrottle target = lerpPercentage((DShotThrottle)0, kDShotMaxThrottle, (uint8_t)std::clamp<int8_t>(percentage, 0, 100));
+        if (_setpointMode != ESCSetpointMode::Queued) {
+            _preemptThrottle(target, duration);
+            return;
+        }
+        _runOperation({ESCOperation<DShotThrottle>("Set Throttle", {{0_us, _lastQueuedThrottle()}, {duration, target}}).withEasing(ESCEasing::Smoothstep),
+                       std::nullopt, []() {}});
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::decreaseThrottle(int8_t percentage, UsTime duration) {
+        if (_setpointMode != ESCSetpointMode::Queued) {
+            increaseThrottle(-percentage, duration);
+            return;
+        }
+        _runOperation({_changeThrottleOp(-percentage, duration), std::nullopt, []() {}});
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::increaseThrottle(int8_t percentage, UsTime duration) {
+        if (_setpointMode != ESCSetpointMode::Queued) {
+            const DShotThrottle lastThrottle = _lastQueuedThrottle();
+            _preemptThrottle(std::clamp(lastThrottle + ((int32_t)percentage * kDShotMaxThrottle) / 100, (DShotThrottle)0, kDShotMaxThrottle), duration);
+            return;
+        }
+        _runOperation({_changeThrottleOp(percentage, duration), std::nullopt, []() {}});
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_runOperation(QueuedOperation&& op) {
+        {
+            std::lock_guard<std::mutex> guard(_operationQueueMutex);
+            if (!_operationQueue.push_back(std::move(op))) {
+                PCP_LOGE("ESC operation queue full, dropping %s", op.operation._name);
+                return;
+            }
+        }
+        xSemaphoreGive(_taskSemaphore);
+    }
+
+    // Cancels any throttle changes that haven't finished, and ramps to target from the current output.
+    // Anything non-preemptible still plays out first, and the ramp follows on from where it ends.
+    template <ESCProtocol protocol>
+    void ESCControlSchemeDShot<protocol>::_preemptThrottle(DShotThrottle target, UsTime duration) {
+        FixedVector<Completion, kOperationQueueCapacity> cancelled;
+        {
+            std::lock_guard<std::mutex> guard(_operationQueueMutex);
+            const size_t firstPending = _frontOperationStarted ? 1 : 0;
+            while (_operationQueue.size() > firstPending && _operationQueue.back().operation._preemptible) {
+                cancelled.push_back(std::move(_operationQueue.back().completion));
+                _operationQueue.pop_back();
+            }
+
+            const bool replaceFront = _operationQueue.size() == 1 && _frontOperationStarted && _operationQueue.front().operation._preemptible;
+            DShotThrottle from = _lastQueuedThrottleLocked();
+            ESCOperationSlope slope;
+            if (replaceFront) {
+                from = _throttle;
+                slope = _operationCursor.slope();
+            }
+
+            ESCOperation<DShotThrottle> op =
+                _setpointMode == ESCSetpointMode::PreemptSmooth
+                    ? blendedRamp<DShotThrottle>("Change Throttle", from, slope, target, duration, 1, kDShotMaxThrottle)
+                    : ESCOperation<DShotThrottle>("Change Throttle", {{0_us, from}, {duration, target}}, true).withEasing(ESCEasing::Smoothstep);
+            if (replaceFront) {
+                cancelled.push_back(std::move(_operationQueue.front().completion));
+                _operationQueue.front() = QueuedOperation{std::move(op), std::nullopt, Completion()};
+                _frontOperationStarted = false;
+            } else if (!_operationQueue.push_back(QueuedOperation{std::move(op), std::nullopt, Completion()})) {
+                PCP_LOGE("ESC operation queue full, dropping %s", op._name);
+            }
+        }
+
+        for (Completion& completion : cancelled) {
+            if (completion) {
+                completion();
+            }
+        }
+        xSemaphoreGive(_taskSemaphore);
+    }
+
+    template <ESCProtocol protocol>
+    DShotThrottle ESCControlSchemeDShot<protocol>::_lastQueuedThrottle(void) const {
+        std::lock_guard<std::mutex> guard(_operationQueueMutex);
+        return _lastQueuedThrottleLocked();
+    }
+
+    // With _operationQueueMutex held.
+    template <ESCProtocol protocol>
+    DShotThrottle ESCControlSchemeDShot<protocol>::_lastQueuedThrottleLocked(void) const {
+        for (auto iter = _operationQueue.rbegin(); iter != _operationQueue.rend(); ++iter) {
+            const ESCOperation<DShotThrottle>& op = iter->operation;
+            if (!op._speeds.empty()) {
+                return op._speeds.back().second;
+            }
+        }
+        return _throttle;
+    }
+
+    template <ESCProtocol protocol>
+    void _dshotUpdateTask(void* userInfo) {
+        ESCControlSchemeDShot<protocol>* motor = reinterpret_cast<ESCControlSchemeDShot<protocol>*>(userInfo);
+
+        TickType_t wait = portMAX_DELAY;
+        while (true) {
+            xSemaphoreTake(motor->_taskSemaphore, wait);
+            wait = motor->_serviceOperationQueue();
+        }
+    }
+
+    template <ESCProtocol protocol>
+    bool _dshotReceiveDone(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* edata, void* userInfo) {
+        ESCControlSchemeDShot<protocol>* motor = reinterpret_cast<ESCControlSchemeDShot<protocol>*>(userInfo);
+        return motor->_receiveReply(edata);
+    }
+}  // namespace pcp
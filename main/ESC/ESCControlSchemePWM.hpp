@@ -1,10 +1,14 @@
 #pragma once
 
+#include "ESCControlScheme.hpp"
 #include "ESCOperation.hpp"
+#include "ESCPWMTimer.hpp"
+#include "ESCProtocol.hpp"
 #include "Log.hpp"
 #include "Pins.hpp"
+#include "Utilities/FixedVector.hpp"
 #include "Utilities/Maths.hpp"
-#include "Utilities/MsTime.hpp"
+#include "Utilities/Time.hpp"
 #include "Utilities/freeRTOSErrorString.hpp"
 
 #include "driver/mcpwm_cmpr.h"
@@ -17,184 +21,355 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <deque>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <tuple>
-#include <vector>
 
 namespace pcp {
+    // Pulse widths are measured in ticks of the protocol's timer.
     using PWMPulseWidth = int32_t;
 
-    template <PWMPulseWidth minThrottlePWM = 1000, PWMPulseWidth maxThrottlePWM = 2000>
-    class ESCControlSchemePWM {
+    static constexpr int32_t kArmSpeed = 2;
+    static constexpr size_t kOperationQueueCapacity = 8;
+
+    // Drives one ESC from an operator of an ESCPWMTimer.  ESCs that share a timer pulse in phase, with one
+    // interrupt per frame between them; without one the scheme makes a timer of its own.  A scheme can be
+    // armed again after disarming, and within the arm profile's warm window that skips the full sequence.
+    template <ESCProtocol protocol = ESCProtocol::PWM50>
+    class ESCControlSchemePWM : public ESCControlScheme, public ESCPWMTimerChannel {
     public:
-        ESCControlSchemePWM();
-        ~ESCControlSchemePWM();
+        using Timing = ESCProtocolTiming<protocol>;
+        // The protocol's nominal endpoints, which the arming sequence is made of.  Throttle percentages map
+        // onto the ESC's own endpoints instead.
+        static constexpr PWMPulseWidth minThrottlePWM = Timing::kMinThrottleTicks;
+        static constexpr PWMPulseWidth maxThrottlePWM = Timing::kMaxThrottleTicks;
+
+        ESCControlSchemePWM(std::shared_ptr<ESCPWMTimer> timer = nullptr, gpio_num_t outputGPIO = kMotorOutputGPIO, ESCThrottleEndpoints endpoints = {},
+                            ESCArmProfile armProfile = {});
+        virtual ~ESCControlSchemePWM();
 
-        bool isArmed(void) const;
+        virtual bool isArmed(void) const override;
 
-        ESCState escState(void) const { return _state; }
+        virtual ESCState escState(void) const override { return _state; }
 
-        void arm(Completion completion = []() {});
-        void disarm(Completion completion = []() {});
-        void setThrottle(int8_t percentage, MsTime duration = 0);
-        void decreaseThrottle(int8_t percentage, MsTime duration);
-        void increaseThrottle(int8_t percentage, MsTime duration);
-        uint8_t throttle() const;
+        virtual void arm(Completion completion = []() {}) override;
+        virtual void disarm(Completion completion = []() {}) override;
+        virtual void setSetpointMode(ESCSetpointMode mode) override { _setpointMode = mode; }
+        virtual void setThrottle(int8_t percentage, UsTime duration = 0_us) override;
+        virtual void decreaseThrottle(int8_t percentage, UsTime duration) override;
+        virtual void increaseThrottle(int8_t percentage, UsTime duration) override;
+        virtual uint8_t throttle() const override;
+        virtual bool engageFailsafeFromISR(uint8_t percentage) override;
+        virtual void releaseFailsafe(void) override;
 
-        std::string stateString(void) const;
+        virtual std::string stateString(void) const override;
+
+        // The comparator is latched at the start of each frame, so the value written here is the one used
+        // for the whole of the next frame.
+        virtual bool advanceFrame(void) override;
 
     private:
+        // A ramp towards the latest setpoint, played out by the timer ISR.
+        struct SetpointRamp {
+            PWMPulseWidth from;
+            PWMPulseWidth to;
+            UsTime duration;
+            UsTime time;
+        };
+
+        struct PendingSetpoint {
+            PWMPulseWidth target;
+            UsTime duration;
+        };
+
         uint8_t _throttleForPWM(PWMPulseWidth pwm) const;
         PWMPulseWidth _pwmForThrottle(uint8_t throttle) const;
 
-        ESCOperation<PWMPulseWidth> _changeThrottleOp(int8_t percentage, MsTime duration) const;
+        ESCOperation<PWMPulseWidth> _changeThrottleOp(int8_t percentage, UsTime duration) const;
         void _runOperation(const ESCOperation<PWMPulseWidth>& op, Completion completion);
+        void _preemptThrottle(PWMPulseWidth target, UsTime duration);
+        void _requestSetpoint(PWMPulseWidth target, UsTime duration);
+        void _advanceSetpointRamp(void);
 
-        void _setupTimers(void);
+        bool _setupChannel(void);
 
-        std::optional<MsTime> _updateThrottle();
+        void _serviceOperationQueue(void);
+        void _startOperation(const ESCOperation<PWMPulseWidth>& operation);
         void _setThrottlePWM(PWMPulseWidth throttlePWM);
 
-        void _timeAdvance(uint32_t deltaT);
-
         PWMPulseWidth _lastQueuedPWM(void) const;
+        PWMPulseWidth _lastQueuedPWMLocked(void) const;
         uint8_t _lastQueuedThrottle(void) const;
+        PWMPulseWidth _lastTargetPWM(void) const;
 
-        template <PWMPulseWidth min, PWMPulseWidth max>
-        friend bool _timerFull(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
-        template <PWMPulseWidth min, PWMPulseWidth max>
+        template <ESCProtocol p>
         friend void _updateThrottleTask(void* userInfo);
 
-        mcpwm_timer_handle_t _timerHandle = nullptr;
+        std::shared_ptr<ESCPWMTimer> _timer;
+        const gpio_num_t _outputGPIO;
+        const PWMPulseWidth _minThrottlePWM;
+        const PWMPulseWidth _maxThrottlePWM;
+        const ESCArmProfile _armProfile;
+        const ESCOperation<PWMPulseWidth> _coldArmOp;
+        const ESCOperation<PWMPulseWidth> _warmArmOp;
+        // When the ESC was last disarmed, having been armed.  Within the profile's warm window of this it can
+        // be warm armed.
+        std::optional<EspTimerClock::time_point> _disarmedAt;
+        bool _attached = false;
         mcpwm_oper_handle_t _operatorHandle = nullptr;
         mcpwm_gen_handle_t _generatorHandle = nullptr;
         mcpwm_cmpr_handle_t _comparatorHandle = nullptr;
-        MsTime _time = 0;
         PWMPulseWidth _throttlePWM = 0;
         ESCState _state = ESCState::Disarmed;
-
-        std::deque<std::pair<ESCOperation<PWMPulseWidth>, Completion>> _operationQueue;
+        ESCSetpointMode _setpointMode = ESCSetpointMode::Queued;
+
+        // The operation being played out by the timer ISR, and how far through it we are, plus the latest
+        // setpoint, which only takes effect while no queued operation is waiting.  Guarded by
+        // _operationLock, as they're shared with the ISR.
+        mutable portMUX_TYPE _operationLock = portMUX_INITIALIZER_UNLOCKED;
+        const ESCOperation<PWMPulseWidth>* _activeOperation = nullptr;
+        ESCOperationCursor<PWMPulseWidth> _operationCursor;
+        UsTime _nextOperationChange;
+        UsTime _time;
+        bool _operationQueueBusy = false;
+        std::optional<PendingSetpoint> _pendingSetpoint;
+        std::optional<SetpointRamp> _setpointRamp;
+        // While set, the output is held here and operations and setpoints wait.
+        std::optional<PWMPulseWidth> _failsafePWM;
+
+        // Operations and their completions are stored inline, so queuing one never allocates.
+        mutable std::mutex _operationQueueMutex;
+        FixedVector<std::pair<ESCOperation<PWMPulseWidth>, Completion>, kOperationQueueCapacity> _operationQueue;
+        bool _frontOperationStarted = false;
         TaskHandle_t _updateTask = nullptr;
         SemaphoreHandle_t _taskSemaphore = nullptr;
 
-        static ESCOperation<PWMPulseWidth> _armOp;
-        static ESCOperation<PWMPulseWidth> _disarmOp;
+        static constexpr ESCOperation<PWMPulseWidth> _disarmOp = ESCOperation<PWMPulseWidth>("Disarm", {
+                                                                                                          {0_s / kArmSpeed, 0},
+                                                                                                          {1_s / kArmSpeed, 0},
+                                                                                                      });
     };
 
     static constexpr uint32_t kInteruptPriority = 3;
-    static constexpr uint32_t kArmSpeed = 2;
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    ESCOperation<PWMPulseWidth> ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_armOp =
-        ESCOperation<PWMPulseWidth>("Arm", {
-                                               {0_s / kArmSpeed, 0},
-                                               {1_s / kArmSpeed, 0},
-                                               {1_s / kArmSpeed, minThrottlePWM / 2},
-                                               {2_s / kArmSpeed, (minThrottlePWM + maxThrottlePWM) / 2},
-                                               {3_s / kArmSpeed, minThrottlePWM / 2},
-                                               {4_s / kArmSpeed, minThrottlePWM / 2},
-                                           });
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    ESCOperation<PWMPulseWidth> ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_disarmOp = ESCOperation<PWMPulseWidth>("Disarm", {
-                                                                                                                                           {0_s / kArmSpeed, 0},
-                                                                                                                                           {1_s / kArmSpeed, 0},
-                                                                                                                                       });
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    bool _timerFull(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    bool _timerStopped(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
+
+    template <ESCProtocol protocol>
     void _updateThrottleTask(void* userInfo);
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::ESCControlSchemePWM() {
-        _setupTimers();
+    template <ESCProtocol protocol>
+    ESCControlSchemePWM<protocol>::ESCControlSchemePWM(std::shared_ptr<ESCPWMTimer> timer, gpio_num_t outputGPIO, ESCThrottleEndpoints endpoints,
+                                                       ESCArmProfile armProfile)
+        : _timer(timer != nullptr ? std::move(timer) : std::make_shared<ESCPWMTimer>(protocol)),
+          _outputGPIO(outputGPIO),
+          _minThrottlePWM(std::clamp<PWMPulseWidth>(Timing::throttleTicks(endpoints.min), 1, Timing::kFramePeriodTicks - 2)),
+          _maxThrottlePWM(std::clamp<PWMPulseWidth>(Timing::throttleTicks(endpoints.max), _minThrottlePWM + 1, Timing::kFramePeriodTicks - 1)),
+          _armProfile(armProfile),
+          _coldArmOp("Arm", {
+                                {0 * armProfile.coldStep, 0},
+                                {1 * armProfile.coldStep, 0},
+                                {1 * armProfile.coldStep, minThrottlePWM / 2},
+                                {2 * armProfile.coldStep, (minThrottlePWM + maxThrottlePWM) / 2},
+                                {3 * armProfile.coldStep, minThrottlePWM / 2},
+                                {4 * armProfile.coldStep, minThrottlePWM / 2},
+                            }),
+          _warmArmOp("Warm Arm", {{0_us, _minThrottlePWM}, {armProfile.warmHold, _minThrottlePWM}}) {
+        assert(_timer->protocol() == protocol && "ESCs sharing a timer must use the same protocol");
+        const bool channelReady = _setupChannel();
         _taskSemaphore = xQueueGenericCreate((UBaseType_t)1, semSEMAPHORE_QUEUE_ITEM_LENGTH, queueQUEUE_TYPE_BINARY_SEMAPHORE);
-        BaseType_t err = xTaskCreate(_updateThrottleTask<minThrottlePWM, maxThrottlePWM>, "Throttle Update Task", 8192, this, 10, &_updateTask);
+        BaseType_t err = xTaskCreate(_updateThrottleTask<protocol>, "Throttle Update Task", 8192, this, 10, &_updateTask);
         if (err != pdPASS) {
             PCP_LOGE("Motor task creation failed: %s", freeRTOSErrorString(err));
         }
+
+        // Only once everything the ISR touches exists.
+        if (channelReady) {
+            _attached = _timer->attach(this);
+            if (!_attached) {
+                PCP_LOGE("Every operator of the ESC timer is already in use");
+            }
+        }
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::~ESCControlSchemePWM() {
+    template <ESCProtocol protocol>
+    ESCControlSchemePWM<protocol>::~ESCControlSchemePWM() {
+        if (_attached) {
+            _timer->detach(this);
+        }
+        if (isArmed() || _state == ESCState::Arming || _state == ESCState::Disarming) {
+            _timer->stop();
+        }
+
         vTaskDelete(_updateTask);
         vSemaphoreDelete(_taskSemaphore);
 
-        mcpwm_timer_disable(_timerHandle);
         mcpwm_del_generator(_generatorHandle);
         mcpwm_del_comparator(_comparatorHandle);
         mcpwm_del_operator(_operatorHandle);
-        mcpwm_del_timer(_timerHandle);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    std::optional<MsTime> ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_updateThrottle() {
-        if (_comparatorHandle == nullptr) {
-            return std::optional<MsTime>();
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_serviceOperationQueue(void) {
+        if (!_attached) {
+            return;
         }
 
-        do {
-            if (_operationQueue.empty()) {
-                return std::optional<MsTime>();
-            }
-            const ESCOperation<PWMPulseWidth>& operation = _operationQueue.front().first;
-            if (operation.empty()) {
-                _operationQueue.pop_front();
-            } else if (operation._speeds.back().first < _time) {
-                _setThrottlePWM(operation._speeds.back().second);
+        while (true) {
+            Completion completion;
+            {
+                std::lock_guard<std::mutex> guard(_operationQueueMutex);
+                if (_operationQueue.empty()) {
+                    portENTER_CRITICAL(&_operationLock);
+                    _operationQueueBusy = false;
+                    portEXIT_CRITICAL(&_operationLock);
+                    return;
+                }
 
-                const Completion& completion = _operationQueue.front().second;
-                if (completion) {
-                    completion();
+                if (!_frontOperationStarted) {
+                    _frontOperationStarted = true;
+                    _startOperation(_operationQueue.front().first);
+                    continue;
                 }
 
-                _time = 0;
+                portENTER_CRITICAL(&_operationLock);
+                const bool frontOperationRunning = _activeOperation != nullptr;
+                portEXIT_CRITICAL(&_operationLock);
+                if (frontOperationRunning) {
+                    return;
+                }
+
+                completion = std::move(_operationQueue.front().second);
                 _operationQueue.pop_front();
-            } else {
-                break;
+                _frontOperationStarted = false;
             }
-        } while (true);
 
-        const ESCOperation<PWMPulseWidth>& operation = _operationQueue.front().first;
-        MsTime timeToNextUpdate;
-        const PWMPulseWidth speed = operation.at(_time, timeToNextUpdate);
+            if (completion) {
+                completion();
+            }
+        }
+    }
 
-        _setThrottlePWM(speed);
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_startOperation(const ESCOperation<PWMPulseWidth>& operation) {
+        if (operation.empty()) {
+            return;
+        }
+
+        portENTER_CRITICAL(&_operationLock);
+        _time = 0_us;
+        _operationCursor = ESCOperationCursor<PWMPulseWidth>(operation);
+        if (_failsafePWM.has_value()) {
+            // The failsafe keeps the comparator.  advanceFrame() writes the operation's output from the first
+            // frame after it's released, and finishes it then if it's already over.
+            _activeOperation = &operation;
+            _nextOperationChange = _time;
+        } else if (_operationCursor.finished(_time)) {
+            _setThrottlePWM(operation._speeds.back().second);
+        } else {
+            _activeOperation = &operation;
+            _setThrottlePWM(_operationCursor.at(_time, _nextOperationChange));
+        }
+        portEXIT_CRITICAL(&_operationLock);
+    }
+
+    // Frames before the operation's output next changes cost a comparison.
+    template <ESCProtocol protocol>
+    bool ESCControlSchemePWM<protocol>::advanceFrame(void) {
+        bool operationFinished = false;
+
+        portENTER_CRITICAL_ISR(&_operationLock);
+        const ESCOperation<PWMPulseWidth>* operation = _activeOperation;
+        if (_failsafePWM.has_value()) {
+            // Hold until released.
+        } else if (operation != nullptr) {
+            _time += Timing::kFramePeriod;
+            if (_operationCursor.finished(_time)) {
+                _setThrottlePWM(operation->_speeds.back().second);
+                _activeOperation = nullptr;
+                operationFinished = true;
+            } else if (_time >= _nextOperationChange) {
+                _setThrottlePWM(_operationCursor.at(_time, _nextOperationChange));
+            }
+        } else if (!_operationQueueBusy) {
+            _advanceSetpointRamp();
+        }
+        portEXIT_CRITICAL_ISR(&_operationLock);
 
-        assert(timeToNextUpdate < 60'000_ms && "We shouldn't be asking to wait a whole minute, that's madness.");
+        if (!operationFinished) {
+            return false;
+        }
 
-        return timeToNextUpdate;
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        xSemaphoreGiveFromISR(_taskSemaphore, &higherPriorityTaskWoken);
+        return higherPriorityTaskWoken == pdTRUE;
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_setThrottlePWM(PWMPulseWidth throttlePWM) {
-        _throttlePWM = std::clamp(throttlePWM, (PWMPulseWidth)0, (PWMPulseWidth)maxThrottlePWM);
+    // Called from the timer ISR with _operationLock held.  A new setpoint restarts the ramp from the
+    // current output, so however many arrived since the last frame only the latest one matters.
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_advanceSetpointRamp(void) {
+        if (_pendingSetpoint.has_value()) {
+            _setpointRamp = SetpointRamp{.from = _throttlePWM, .to = _pendingSetpoint->target, .duration = _pendingSetpoint->duration, .time = 0_us};
+            _pendingSetpoint.reset();
+        }
+
+        if (!_setpointRamp.has_value()) {
+            return;
+        }
+
+        SetpointRamp& ramp = _setpointRamp.value();
+        ramp.time = std::min(ramp.time + Timing::kFramePeriod, ramp.duration);
+        if (ramp.time >= ramp.duration) {
+            _setThrottlePWM(ramp.to);
+            _setpointRamp.reset();
+            return;
+        }
+
+        const int64_t change = (int64_t)(ramp.to - ramp.from) * ramp.time.count() / ramp.duration.count();
+        _setThrottlePWM(ramp.from + (PWMPulseWidth)change);
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_setThrottlePWM(PWMPulseWidth throttlePWM) {
+        _throttlePWM = std::clamp(throttlePWM, (PWMPulseWidth)0, std::max(maxThrottlePWM, _maxThrottlePWM));
         esp_err_t err = mcpwm_comparator_set_compare_value(_comparatorHandle, _throttlePWM);
         if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while updating comparator value: %s", esp_err_to_name(err));
+            PCP_DRAM_LOGE("Error occurred while updating comparator value: %s", esp_err_to_name(err));
         }
 
         if (isArmed()) {
-            _state = _throttlePWM <= minThrottlePWM ? ESCState::Armed : ESCState::Running;
+            _state = _throttlePWM <= _minThrottlePWM ? ESCState::Armed : ESCState::Running;
         }
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    uint8_t ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::throttle() const {
+    template <ESCProtocol protocol>
+    uint8_t ESCControlSchemePWM<protocol>::throttle() const {
         return _throttleForPWM(_throttlePWM);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    std::string ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::stateString(void) const {
+    // The comparator is written straight away, so the failsafe output starts with the next frame.
+    template <ESCProtocol protocol>
+    bool ESCControlSchemePWM<protocol>::engageFailsafeFromISR(uint8_t percentage) {
+        portENTER_CRITICAL_SAFE(&_operationLock);
+        if (isArmed()) {
+            _failsafePWM = _pwmForThrottle(std::min<uint8_t>(percentage, 100));
+            _setThrottlePWM(_failsafePWM.value());
+        }
+        portEXIT_CRITICAL_SAFE(&_operationLock);
+        return false;
+    }
+
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::releaseFailsafe(void) {
+        portENTER_CRITICAL(&_operationLock);
+        _failsafePWM.reset();
+        portEXIT_CRITICAL(&_operationLock);
+    }
+
+    template <ESCProtocol protocol>
+    std::string ESCControlSchemePWM<protocol>::stateString(void) const {
         switch (escState()) {
             case ESCState::Disarmed: return "Disarmed";
             case ESCState::Arming: return "Arming...";
@@ -206,38 +381,21 @@ namespace pcp {
         return "";
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    uint8_t ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_throttleForPWM(PWMPulseWidth pwm) const {
-        return invLerpPercentage(pwm, minThrottlePWM, maxThrottlePWM);
+    template <ESCProtocol protocol>
+    uint8_t ESCControlSchemePWM<protocol>::_throttleForPWM(PWMPulseWidth pwm) const {
+        return invLerpPercentage(pwm, _minThrottlePWM, _maxThrottlePWM);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    PWMPulseWidth ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_pwmForThrottle(uint8_t throttle) const {
-        return lerpPercentage(minThrottlePWM, maxThrottlePWM, throttle);
+    template <ESCProtocol protocol>
+    PWMPulseWidth ESCControlSchemePWM<protocol>::_pwmForThrottle(uint8_t throttle) const {
+        return lerpPercentage(_minThrottlePWM, _maxThrottlePWM, throttle);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_setupTimers(void) {
+    template <ESCProtocol protocol>
+    bool ESCControlSchemePWM<protocol>::_setupChannel(void) {
         esp_err_t err = ESP_OK;
 
-        mcpwm_timer_config_t timerConfig = {.group_id = 0,
-                                            .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
-                                            .resolution_hz = 1'000'000,
-                                            .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
-                                            .period_ticks = 20'000,
-                                            .intr_priority = kInteruptPriority,
-                                            .flags = {
-                                                .update_period_on_empty = false,
-                                                .update_period_on_sync = false,
-                                                .allow_pd = false,
-                                            }};
-        err = mcpwm_new_timer(&timerConfig, &_timerHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while creating timer: %s", esp_err_to_name(err));
-            return;
-        }
-
-        mcpwm_operator_config_t operatorConfig = {.group_id = 0,
+        mcpwm_operator_config_t operatorConfig = {.group_id = ESCPWMTimer::kGroupID,
                                                   .intr_priority = kInteruptPriority,
                                                   .flags = {
                                                       .update_gen_action_on_tez = false,
@@ -250,43 +408,32 @@ namespace pcp {
         err = mcpwm_new_operator(&operatorConfig, &_operatorHandle);
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while creating operator: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
-        err = mcpwm_operator_connect_timer(_operatorHandle, _timerHandle);
+        err = mcpwm_operator_connect_timer(_operatorHandle, _timer->handle());
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while attaching operator to timer: %s", esp_err_to_name(err));
-            return;
-        }
-
-        mcpwm_timer_event_callbacks_t timerCallbacks = {
-            .on_full = _timerFull<minThrottlePWM, maxThrottlePWM>,
-            .on_empty = nullptr,
-            .on_stop = _timerStopped<minThrottlePWM, maxThrottlePWM>,
-        };
-        err = mcpwm_timer_register_event_callbacks(_timerHandle, &timerCallbacks, this);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while setting up timer callbacks: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
 
         mcpwm_comparator_config_t comparatorConfig = {.intr_priority = kInteruptPriority,
                                                       .flags{
-                                                          .update_cmp_on_tez = false,
+                                                          .update_cmp_on_tez = true,
                                                           .update_cmp_on_tep = false,
                                                           .update_cmp_on_sync = false,
                                                       }};
         err = mcpwm_new_comparator(_operatorHandle, &comparatorConfig, &_comparatorHandle);
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while creating comparator: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
         err = mcpwm_comparator_set_compare_value(_comparatorHandle, 0);
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while setting comparator value: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
 
-        mcpwm_generator_config_t generatorCongif = {.gen_gpio_num = kMotorOutputGPIO,
+        mcpwm_generator_config_t generatorCongif = {.gen_gpio_num = _outputGPIO,
                                                     .flags = {
                                                         .invert_pwm = false,
                                                         .io_loop_back = false,
@@ -297,107 +444,194 @@ namespace pcp {
         err = mcpwm_new_generator(_operatorHandle, &generatorCongif, &_generatorHandle);
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while creating generator: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
         err = mcpwm_generator_set_action_on_timer_event(
             _generatorHandle,
             (mcpwm_gen_timer_event_action_t){.direction = MCPWM_TIMER_DIRECTION_UP, .event = MCPWM_TIMER_EVENT_EMPTY, .action = MCPWM_GEN_ACTION_HIGH});
         if (err != ESP_OK) {
             PCP_LOGE("While setting generator to output high on timer reset: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
         err = mcpwm_generator_set_action_on_compare_event(
             _generatorHandle,
             (mcpwm_gen_compare_event_action_t){.direction = MCPWM_TIMER_DIRECTION_UP, .comparator = _comparatorHandle, .action = MCPWM_GEN_ACTION_LOW});
         if (err != ESP_OK) {
             PCP_LOGE("Error occurred while setting generator to output low on comparator match: %s", esp_err_to_name(err));
-            return;
+            return false;
         }
 
-        err = mcpwm_timer_enable(_timerHandle);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while enabling timer: %s", esp_err_to_name(err));
-            return;
-        }
+        return true;
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    bool ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::isArmed(void) const {
+    template <ESCProtocol protocol>
+    bool ESCControlSchemePWM<protocol>::isArmed(void) const {
         return _state == ESCState::Armed || _state == ESCState::Running;
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::arm(Completion completion) {
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::arm(Completion completion) {
         assert(_state == ESCState::Disarmed);
 
-        esp_err_t err = ESP_OK;
-        err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_START_NO_STOP);
-        if (err != ESP_OK) {
-            PCP_LOGE("Error occurred while starting timer: %s", esp_err_to_name(err));
-            return;
-        }
+        const bool warm = _disarmedAt.has_value() && EspTimerClock::now() - _disarmedAt.value() <= _armProfile.warmWindow;
+        _disarmedAt.reset();
 
+        _timer->start();
         _state = ESCState::Arming;
-        _runOperation(_armOp, [this, completion]() {
-            this->_state = this->_throttlePWM <= minThrottlePWM ? ESCState::Armed : ESCState::Running;
+        _runOperation(warm ? _warmArmOp : _coldArmOp, [this, completion]() {
+            this->_state = this->_throttlePWM <= _minThrottlePWM ? ESCState::Armed : ESCState::Running;
             completion();
         });
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::disarm(Completion completion) {
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::disarm(Completion completion) {
+        releaseFailsafe();
+        const bool wasArmed = isArmed();
         _state = ESCState::Disarming;
-        _runOperation(_disarmOp, [this, completion]() {
+        _runOperation(_disarmOp, [this, completion, wasArmed]() {
             this->_state = ESCState::Disarmed;
-            esp_err_t err = ESP_OK;
-            err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_STOP_EMPTY);
-            if (err != ESP_OK) {
-                PCP_LOGE("Error occurred while stopping timer: %s", esp_err_to_name(err));
-                return;
+            if (wasArmed) {
+                this->_disarmedAt = EspTimerClock::now();
             }
+            this->_timer->stop();
             completion();
         });
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    ESCOperation<PWMPulseWidth> ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_changeThrottleOp(int8_t percentage, MsTime duration) const {
-        const uint32_t lastPWM = std::clamp(_lastQueuedPWM(), minThrottlePWM, maxThrottlePWM);
-        uint32_t newPWM = (uint32_t)(lastPWM + ((int32_t)percentage * (int32_t)(maxThrottlePWM - minThrottlePWM)) / 100);
-        return ESCOperation<PWMPulseWidth>("Change Throttle", {{0, lastPWM}, {duration, newPWM}});
+    template <ESCProtocol protocol>
+    ESCOperation<PWMPulseWidth> ESCControlSchemePWM<protocol>::_changeThrottleOp(int8_t percentage, UsTime duration) const {
+        const uint32_t lastPWM = std::clamp(_lastQueuedPWM(), _minThrottlePWM, _maxThrottlePWM);
+        uint32_t newPWM = (uint32_t)(lastPWM + ((int32_t)percentage * (int32_t)(_maxThrottlePWM - _minThrottlePWM)) / 100);
+        return ESCOperation<PWMPulseWidth>("Change Throttle", {{0_us, lastPWM}, {duration, newPWM}}).withEasing(ESCEasing::Smoothstep);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::setThrottle(int8_t percentage, MsTime duration) {
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::setThrottle(int8_t percentage, UsTime duration) {
+        switch (_setpointMode) {
+            case ESCSetpointMode::Queued: break;
+            case ESCSetpointMode::LatestWins: _requestSetpoint(_pwmForThrottle(std::clamp<int8_t>(percentage, 0, 100)), duration); return;
+            case ESCSetpointMode::Preempt:  // fallthrough
+            case ESCSetpointMode::PreemptSmooth: _preemptThrottle(_pwmForThrottle(std::clamp<int8_t>(percentage, 0, 100)), duration); return;
+        }
         _runOperation(_changeThrottleOp(percentage - _lastQueuedThrottle(), duration), []() {});
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::decreaseThrottle(int8_t percentage, MsTime duration) {
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::decreaseThrottle(int8_t percentage, UsTime duration) {
+        if (_setpointMode != ESCSetpointMode::Queued) {
+            increaseThrottle(-percentage, duration);
+            return;
+        }
         _runOperation(_changeThrottleOp(-percentage, duration), []() {});
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::increaseThrottle(int8_t percentage, MsTime duration) {
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::increaseThrottle(int8_t percentage, UsTime duration) {
+        if (_setpointMode != ESCSetpointMode::Queued) {
+            const PWMPulseWidth lastPWM = std::clamp(_lastTargetPWM(), _minThrottlePWM, _maxThrottlePWM);
+            const PWMPulseWidth change = ((int32_t)percentage * (_maxThrottlePWM - _minThrottlePWM)) / 100;
+            const PWMPulseWidth target = std::clamp(lastPWM + change, _minThrottlePWM, _maxThrottlePWM);
+            if (_setpointMode == ESCSetpointMode::LatestWins) {
+                _requestSetpoint(target, duration);
+            } else {
+                _preemptThrottle(target, duration);
+            }
+            return;
+        }
         _runOperation(_changeThrottleOp(percentage, duration), []() {});
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_runOperation(const ESCOperation<PWMPulseWidth>& op, Completion completion) {
-        bool isEmpty = _operationQueue.empty();
-        _operationQueue.emplace_back(op, completion);
-        if (isEmpty) {
-            _time = 0;
-            xSemaphoreGive(_taskSemaphore);
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_runOperation(const ESCOperation<PWMPulseWidth>& op, Completion completion) {
+        {
+            std::lock_guard<std::mutex> guard(_operationQueueMutex);
+            if (!_operationQueue.push_back(std::make_pair(op, completion))) {
+                PCP_LOGE("ESC operation queue full, dropping %s", op._name);
+                return;
+            }
+            portENTER_CRITICAL(&_operationLock);
+            _operationQueueBusy = true;
+            _pendingSetpoint.reset();
+            _setpointRamp.reset();
+            portEXIT_CRITICAL(&_operationLock);
         }
+        xSemaphoreGive(_taskSemaphore);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    void ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_timeAdvance(uint32_t deltaT) {
-        _time += deltaT;
+    // Cancels any throttle changes that haven't finished, and ramps to target from the current output.
+    // Anything non-preemptible (arming, say) still plays out first, and the ramp follows on from where it
+    // ends.  Cancelled operations' completions are called, as there's nothing left of them to wait for.
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_preemptThrottle(PWMPulseWidth target, UsTime duration) {
+        FixedVector<Completion, kOperationQueueCapacity> cancelled;
+        {
+            std::lock_guard<std::mutex> guard(_operationQueueMutex);
+            const size_t firstPending = _frontOperationStarted ? 1 : 0;
+            while (_operationQueue.size() > firstPending && _operationQueue.back().first._preemptible) {
+                cancelled.push_back(std::move(_operationQueue.back().second));
+                _operationQueue.pop_back();
+            }
+
+            const bool replaceFront = _operationQueue.size() == 1 && _frontOperationStarted && _operationQueue.front().first._preemptible;
+            PWMPulseWidth from = _lastQueuedPWMLocked();
+            ESCOperationSlope slope;
+            if (replaceFront) {
+                // Stop the ISR playing the operation out before it's overwritten.
+                portENTER_CRITICAL(&_operationLock);
+                from = _throttlePWM;
+                if (_activeOperation != nullptr) {
+                    slope = _operationCursor.slope();
+                }
+                _activeOperation = nullptr;
+                portEXIT_CRITICAL(&_operationLock);
+            }
+
+            const ESCOperation<PWMPulseWidth> op =
+                _setpointMode == ESCSetpointMode::PreemptSmooth
+                    ? blendedRamp<PWMPulseWidth>("Change Throttle", from, slope, target, duration, _minThrottlePWM, _maxThrottlePWM)
+                    : ESCOperation<PWMPulseWidth>("Change Throttle", {{0_us, from}, {duration, target}}, true).withEasing(ESCEasing::Smoothstep);
+            if (replaceFront) {
+                cancelled.push_back(std::move(_operationQueue.front().second));
+                _operationQueue.front() = std::make_pair(op, Completion());
+                _startOperation(_operationQueue.front().first);
+            } else if (!_operationQueue.push_back(std::make_pair(op, Completion()))) {
+                PCP_LOGE("ESC operation queue full, dropping %s", op._name);
+            } else {
+                portENTER_CRITICAL(&_operationLock);
+                _operationQueueBusy = true;
+                _pendingSetpoint.reset();
+                _setpointRamp.reset();
+                portEXIT_CRITICAL(&_operationLock);
+            }
+        }
+
+        for (Completion& completion : cancelled) {
+            if (completion) {
+                completion();
+            }
+        }
+        xSemaphoreGive(_taskSemaphore);
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    PWMPulseWidth ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_lastQueuedPWM(void) const {
+    // Replaces whatever setpoint is pending.  Nothing is allocated or queued, the timer ISR picks it up at
+    // the start of the next frame.
+    template <ESCProtocol protocol>
+    void ESCControlSchemePWM<protocol>::_requestSetpoint(PWMPulseWidth target, UsTime duration) {
+        portENTER_CRITICAL(&_operationLock);
+        _pendingSetpoint = PendingSetpoint{.target = target, .duration = std::max(duration, 0_us)};
+        portEXIT_CRITICAL(&_operationLock);
+    }
+
+    template <ESCProtocol protocol>
+    PWMPulseWidth ESCControlSchemePWM<protocol>::_lastQueuedPWM(void) const {
+        std::lock_guard<std::mutex> guard(_operationQueueMutex);
+        return _lastQueuedPWMLocked();
+    }
+
+    // With _operationQueueMutex held.
+    template <ESCProtocol protocol>
+    PWMPulseWidth ESCControlSchemePWM<protocol>::_lastQueuedPWMLocked(void) const {
         for (auto iter = _operationQueue.rbegin(); iter != _operationQueue.rend(); ++iter) {
             const ESCOperation<PWMPulseWidth>& op = iter->first;
             if (!op._speeds.empty()) {
@@ -407,37 +641,28 @@ namespace pcp {
         return _throttlePWM;
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    uint8_t ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>::_lastQueuedThrottle(void) const {
-        return _throttleForPWM(_lastQueuedPWM());
+    template <ESCProtocol protocol>
+    PWMPulseWidth ESCControlSchemePWM<protocol>::_lastTargetPWM(void) const {
+        portENTER_CRITICAL(&_operationLock);
+        const std::optional<PWMPulseWidth> target = _pendingSetpoint.has_value() ? _pendingSetpoint->target
+                                                    : _setpointRamp.has_value()  ? _setpointRamp->to
+                                                                                 : std::optional<PWMPulseWidth>();
+        portEXIT_CRITICAL(&_operationLock);
+        return target.has_value() ? target.value() : _lastQueuedPWM();
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    bool _timerFull(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx) {
-        ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>* motor = reinterpret_cast<ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>*>(user_ctx);
-        motor->_timeAdvance(20);
-        return false;
-    }
-
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
-    bool _timerStopped(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx) {
-        PCP_LOGW("Timer Stopped!");
-        return false;
+    template <ESCProtocol protocol>
+    uint8_t ESCControlSchemePWM<protocol>::_lastQueuedThrottle(void) const {
+        return _throttleForPWM(_lastQueuedPWM());
     }
 
-    template <PWMPulseWidth minThrottlePWM, PWMPulseWidth maxThrottlePWM>
+    template <ESCProtocol protocol>
     void _updateThrottleTask(void* userInfo) {
-        ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>* motor = reinterpret_cast<ESCControlSchemePWM<minThrottlePWM, maxThrottlePWM>*>(userInfo);
-
-        while (!xSemaphoreTake(motor->_taskSemaphore, portMAX_DELAY)) {}
+        ESCControlSchemePWM<protocol>* motor = reinterpret_cast<ESCControlSchemePWM<protocol>*>(userInfo);
 
         while (true) {
-            std::optional<MsTime> time = motor->_updateThrottle();
-            if (time.has_value()) {
-                vTaskDelay(time.value().get() / portTICK_PERIOD_MS);
-            } else {
-                while (!xSemaphoreTake(motor->_taskSemaphore, portMAX_DELAY)) {}
-            }
+            while (!xSemaphoreTake(motor->_taskSemaphore, portMAX_DELAY)) {}
+            motor->_serviceOperationQueue();
         }
     }
 }  // namespace pcp
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace pcp {
+    // How an ESCOperation moves between two keyframes.  Linear has a step in acceleration at each
+    // keyframe, Smoothstep starts and ends each segment at rest, and Hermite passes through keyframes
+    // with a shared slope (zero at turning points, so it never overshoots a keyframe).
+    enum class ESCEasing : uint8_t {
+        Linear = 0,
+        Smoothstep = 1,
+        Hermite = 2,
+    };
+
+    // Eased curves are evaluated from tables of the cubic Hermite basis functions, sampled at
+    // kEasingTableSteps + 1 evenly spaced points in Q16 fixed point and linearly interpolated between, so
+    // they cost a lookup and a few integer multiplies.
+    static constexpr int64_t kEasingTableSteps = 32;
+    static constexpr int64_t kEasingOne = 1 << 16;
+
+    using EasingTable = std::array<int32_t, kEasingTableSteps + 1>;
+
+    // coefficients are those of a * s^3 + b * s^2 + c * s, for s in [0, 1].
+    constexpr EasingTable makeEasingTable(int64_t a, int64_t b, int64_t c) {
+        constexpr int64_t n = kEasingTableSteps;
+        EasingTable table{};
+        for (int64_t i = 0; i <= n; ++i) {
+            table[i] = static_cast<int32_t>(((a * i * i * i + b * i * i * n + c * i * n * n) * kEasingOne) / (n * n * n));
+        }
+        return table;
+    }
+
+    // The share of the change between the keyframes, 3s^2 - 2s^3, which is also smoothstep.
+    static constexpr EasingTable kHermiteChangeTable = makeEasingTable(-2, 3, 0);
+    // The shares of the start and end tangents, s^3 - 2s^2 + s and s^3 - s^2.
+    static constexpr EasingTable kHermiteStartTangentTable = makeEasingTable(1, -2, 1);
+    static constexpr EasingTable kHermiteEndTangentTable = makeEasingTable(1, -1, 0);
+
+    static_assert(kHermiteChangeTable[0] == 0 && kHermiteChangeTable[kEasingTableSteps] == kEasingOne);
+    static_assert(kHermiteChangeTable[kEasingTableSteps / 2] == kEasingOne / 2);
+    static_assert(kHermiteStartTangentTable[kEasingTableSteps] == 0 && kHermiteEndTangentTable[kEasingTableSteps] == 0);
+}  // namespace pcp
@@ -1,67 +1,305 @@
 #pragma once
 
-#include <string>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <tuple>
-#include <vector>
 
-#include "Utilities/MsTime.hpp"
+#include "ESC/ESCEasing.hpp"
+#include "Utilities/FixedVector.hpp"
+#include "Utilities/Time.hpp"
 
 namespace pcp {
-    template <typename T>
+    // A throttle profile: values at keyframe times, interpolated between with each segment's easing
+    // (linear unless set otherwise).  Keyframes are stored inline, so fixed profiles can be constexpr
+    // tables and runtime ones never allocate.  Times are in microseconds so ramps can be shorter than a
+    // millisecond.  Preemptible operations may be cut short by a later throttle change; arm and disarm
+    // sequences never are.
+    template <typename T, size_t maxKeyframes = 8>
     struct ESCOperation {
-        using DataPoint = std::pair<MsTime, T>;
+        using DataPoint = std::pair<UsTime, T>;
+
+        constexpr ESCOperation() {}
+
+        constexpr ESCOperation(const char* name, std::initializer_list<DataPoint> speeds, bool preemptible = false)
+            : _name(name), _speeds(speeds), _preemptible(preemptible) {}
+
+        constexpr bool empty(void) const { return _speeds.empty(); }
+
+        // A copy with every segment eased.
+        constexpr ESCOperation withEasing(ESCEasing easing) const {
+            ESCOperation operation = *this;
+            operation._easings.fill(easing);
+            return operation;
+        }
+
+        // A copy with the segment that ends at keyframe eased.
+        constexpr ESCOperation withEasing(size_t keyframe, ESCEasing easing) const {
+            ESCOperation operation = *this;
+            operation._easings[keyframe] = easing;
+            return operation;
+        }
+
+        const char* _name = "";
+        FixedVector<DataPoint, maxKeyframes> _speeds;
+        // The easing of the segment ending at each keyframe.
+        std::array<ESCEasing, maxKeyframes> _easings{};
+        bool _preemptible = false;
+    };
+
+    // The rate an operation's output is changing at, as a change in value over a duration.
+    struct ESCOperationSlope {
+        int64_t change = 0;
+        UsTime duration = 1_us;
+    };
+
+    // Plays an ESCOperation out over time.  The cursor remembers which segment it's in, so as long as
+    // time only moves forwards each evaluation is O(1) amortised, and it reports exactly when the output
+    // will next change: the end of a flat segment, or the time the integer ramp value next steps.  Eased
+    // segments are treated as kEasingTableSteps linear pieces.
+    template <typename T, size_t maxKeyframes = 8>
+    class ESCOperationCursor {
+    public:
+        constexpr ESCOperationCursor() {}
+
+        constexpr explicit ESCOperationCursor(const ESCOperation<T, maxKeyframes>& operation) : _operation(&operation) {}
+
+        // True once time has reached the final keyframe.
+        constexpr bool finished(UsTime time) const { return _operation == nullptr || _operation->empty() || time >= _operation->_speeds.back().first; }
 
-        ESCOperation(const std::string& name, const std::initializer_list<DataPoint>& speeds) : _name(name), _speeds(speeds) {}
+        // The output at time, which must not be earlier than the time of the previous call.
+        // outNextChange is set to the earliest time at which the output differs from the returned value.
+        constexpr T at(UsTime time, UsTime& outNextChange);
 
-        T at(MsTime time, MsTime& outTimeToNextUpdate) const;
+        // The slope of the segment the last call to at() landed in.
+        constexpr ESCOperationSlope slope(void) const;
 
-        bool empty(void) const { return _speeds.empty(); }
+    private:
+        // The tangent at keyframe, as the change in value it implies over duration, the length of the segment
+        // being eased.
+        constexpr int64_t _tangent(size_t keyframe, int64_t duration) const;
+        constexpr T _easedValue(size_t step) const;
+        // How far into a segment of duration a table step starts.  Rounded up, so a time always falls
+        // inside the step it was found in.
+        static constexpr int64_t _stepOffset(int64_t step, int64_t duration) { return (step * duration + kEasingTableSteps - 1) / kEasingTableSteps; }
 
-        std::string _name;
-        std::vector<DataPoint> _speeds;
+        const ESCOperation<T, maxKeyframes>* _operation = nullptr;
+        // The index of the first keyframe after the current time.
+        size_t _segmentEnd = 0;
+        // The Hermite tangents of the segment ending at _segmentEnd, worked out when it's entered.
+        size_t _tangentSegment = 0;
+        int64_t _startTangent = 0;
+        int64_t _endTangent = 0;
+        // The table step the last call to at() landed in, within an eased segment.
+        int64_t _step = 0;
     };
 
+    // The value at time along the straight line from (fromTime, from) to (toTime, to), and when it next
+    // steps.  fromTime <= time < toTime.
     template <typename T>
-    T ESCOperation<T>::at(MsTime time, MsTime& outTimeToNextUpdate) const {
-        const auto& secondLast = *(_speeds.end() - 2);
-        const auto& last = *(_speeds.end() - 1);
-
-        MsTime preTime = secondLast.first;
-        MsTime postTime = last.first;
-        T preValue = secondLast.second;
-        T postValue = last.second;
-
-        for (auto iter = _speeds.begin(); iter != _speeds.end(); ++iter) {
-            if (iter->first > time) {
-                if (iter == _speeds.begin()) {
-                    preTime = iter->first;
-                    postTime = iter->first;
-                    preValue = iter->second;
-                    postValue = iter->second;
-                } else {
-                    preTime = (iter - 1)->first;
-                    preValue = (iter - 1)->second;
-                    postTime = iter->first;
-                    postValue = iter->second;
+    constexpr T linearStep(UsTime fromTime, T from, UsTime toTime, T to, UsTime time, UsTime& outNextChange) {
+        if (from == to) {
+            outNextChange = toTime;
+            return from;
+        }
+
+        const int64_t duration = (toTime - fromTime).count();
+        const int64_t elapsed = (time - fromTime).count();
+        const int64_t change = static_cast<int64_t>(to) - static_cast<int64_t>(from);
+        const int64_t magnitude = change < 0 ? -change : change;
+        const int64_t steps = (elapsed * magnitude) / duration;
+        const int64_t nextStepElapsed = ((steps + 1) * duration + magnitude - 1) / magnitude;
+
+        outNextChange = fromTime + UsTime(std::min(nextStepElapsed, duration));
+        return static_cast<T>(from + (change < 0 ? -steps : steps));
+    }
+
+    template <typename T, size_t maxKeyframes>
+    constexpr T ESCOperationCursor<T, maxKeyframes>::at(UsTime time, UsTime& outNextChange) {
+        const auto& speeds = _operation->_speeds;
+        assert(!speeds.empty());
+
+        while (_segmentEnd < speeds.size() && speeds[_segmentEnd].first <= time) {
+            ++_segmentEnd;
+        }
+
+        if (_segmentEnd == speeds.size()) {
+            outNextChange = time;
+            return speeds.back().second;
+        }
+
+        const auto& post = speeds[_segmentEnd];
+        if (_segmentEnd == 0) {
+            outNextChange = post.first;
+            return post.second;
+        }
+
+        // pre.first <= time < post.first, so the segment has a non-zero duration.
+        const auto& pre = speeds[_segmentEnd - 1];
+        const ESCEasing easing = _operation->_easings[_segmentEnd];
+        if (easing == ESCEasing::Linear || pre.second == post.second) {
+            return linearStep(pre.first, pre.second, post.first, post.second, time, outNextChange);
+        }
+
+        const int64_t duration = (post.first - pre.first).count();
+        if (_tangentSegment != _segmentEnd) {
+            _tangentSegment = _segmentEnd;
+            _startTangent = easing == ESCEasing::Hermite ? _tangent(_segmentEnd - 1, duration) : 0;
+            _endTangent = easing == ESCEasing::Hermite ? _tangent(_segmentEnd, duration) : 0;
+        }
+
+        _step = ((time - pre.first).count() * kEasingTableSteps) / duration;
+        const UsTime stepStart = pre.first + UsTime(_stepOffset(_step, duration));
+        const UsTime stepEnd = pre.first + UsTime(_stepOffset(_step + 1, duration));
+        return linearStep(stepStart, _easedValue(_step), stepEnd, _easedValue(_step + 1), time, outNextChange);
+    }
+
+    // Monotone tangents: zero where the value turns round or levels off, otherwise the harmonic mean of
+    // the slopes either side, which keeps the curve from overshooting the keyframes.
+    template <typename T, size_t maxKeyframes>
+    constexpr int64_t ESCOperationCursor<T, maxKeyframes>::_tangent(size_t keyframe, int64_t duration) const {
+        const auto& speeds = _operation->_speeds;
+        if (keyframe == 0 || keyframe + 1 >= speeds.size()) {
+            return 0;
+        }
+
+        const int64_t changeBefore = static_cast<int64_t>(speeds[keyframe].second) - static_cast<int64_t>(speeds[keyframe - 1].second);
+        const int64_t changeAfter = static_cast<int64_t>(speeds[keyframe + 1].second) - static_cast<int64_t>(speeds[keyframe].second);
+        const int64_t durationBefore = (speeds[keyframe].first - speeds[keyframe - 1].first).count();
+        const int64_t durationAfter = (speeds[keyframe + 1].first - speeds[keyframe].first).count();
+        if ((changeBefore < 0) != (changeAfter < 0) || changeBefore == 0 || changeAfter == 0 || durationBefore == 0 || durationAfter == 0) {
+            return 0;
+        }
+
+        return (2 * changeBefore * changeAfter * duration) / (changeBefore * durationAfter + changeAfter * durationBefore);
+    }
+
+    template <typename T, size_t maxKeyframes>
+    constexpr T ESCOperationCursor<T, maxKeyframes>::_easedValue(size_t step) const {
+        const auto& pre = _operation->_speeds[_segmentEnd - 1];
+        const auto& post = _operation->_speeds[_segmentEnd];
+        const int64_t change = static_cast<int64_t>(post.second) - static_cast<int64_t>(pre.second);
+        const int64_t offset =
+            (change * kHermiteChangeTable[step] + _startTangent * kHermiteStartTangentTable[step] + _endTangent * kHermiteEndTangentTable[step]) /
+            kEasingOne;
+        return static_cast<T>(pre.second + offset);
+    }
+
+    template <typename T, size_t maxKeyframes>
+    constexpr ESCOperationSlope ESCOperationCursor<T, maxKeyframes>::slope(void) const {
+        if (_operation == nullptr || _segmentEnd == 0 || _segmentEnd >= _operation->_speeds.size()) {
+            return ESCOperationSlope();
+        }
+
+        const auto& pre = _operation->_speeds[_segmentEnd - 1];
+        const auto& post = _operation->_speeds[_segmentEnd];
+        if (_operation->_easings[_segmentEnd] != ESCEasing::Linear && pre.second != post.second) {
+            const int64_t duration = (post.first - pre.first).count();
+            const int64_t stepDuration = _stepOffset(_step + 1, duration) - _stepOffset(_step, duration);
+            return ESCOperationSlope{.change = static_cast<int64_t>(_easedValue(_step + 1)) - static_cast<int64_t>(_easedValue(_step)),
+                                     .duration = UsTime(std::max<int64_t>(stepDuration, 1))};
+        }
+        return ESCOperationSlope{.change = static_cast<int64_t>(post.second) - static_cast<int64_t>(pre.second), .duration = post.first - pre.first};
+    }
+
+    // True if, stepping through operation a microsecond at a time, the output never changes before the
+    // next-change time the cursor last reported, and that time is always in the future.
+    template <typename T, size_t maxKeyframes>
+    constexpr bool reportsNextChanges(ESCOperation<T, maxKeyframes> operation) {
+        ESCOperationCursor<T, maxKeyframes> cursor(operation);
+        UsTime nextChange = 0_us;
+        T value = cursor.at(0_us, nextChange);
+        for (UsTime time = 1_us; !cursor.finished(time); time += 1_us) {
+            UsTime next = 0_us;
+            const T current = cursor.at(time, next);
+            if (time < nextChange) {
+                if (current != value || next != nextChange) {
+                    return false;
                 }
-                break;
+            } else if (next <= time) {
+                return false;
             }
+            value = current;
+            nextChange = next;
         }
+        return true;
+    }
 
-        T value = preValue;
-        MsTime timeToNextUpdate = 20;
-        if (preValue == postValue) {
-            if (postTime > time) {
-                timeToNextUpdate = postTime - time;
-            }
-        } else {
-            const MsTime timePeriod = postTime - preTime;
-            const MsTime timeIn = clamp(time - preTime, 0_ms, timePeriod);
-            const T valueIncrease = postValue - preValue;
-            const T scaledValueIncrease = timePeriod == 0 ? 0 : (timeIn * valueIncrease) / timePeriod;
-            value = preValue + scaledValueIncrease;
+    static_assert(reportsNextChanges(ESCOperation<int32_t>("", {{0_us, 0}, {1_ms, 100}, {2_ms, 300}}).withEasing(ESCEasing::Hermite)));
+    static_assert(reportsNextChanges(ESCOperation<int32_t>("", {{0_us, 300}, {1_ms, 20}, {1500_us, 20}, {2_ms, 0}}).withEasing(ESCEasing::Hermite)));
+    // Hermite starts at rest and leaves the middle keyframe at the harmonic mean slope of 2/15 per us.
+    static_assert([] {
+        const auto operation = ESCOperation<int32_t>("", {{0_us, 0}, {1_ms, 100}, {2_ms, 300}}).withEasing(ESCEasing::Hermite);
+        ESCOperationCursor<int32_t> cursor(operation);
+        UsTime next = 0_us;
+        const bool start = cursor.at(0_us, next) == 0 && next == 32_us && cursor.at(94_us, next) == 1 && next == 125_us;
+        return start && cursor.at(1000_us, next) == 100 && next == 1008_us && cursor.at(1008_us, next) == 101 && next == 1016_us;
+    }());
+
+    // A preemptible ramp from `from` to `to` over duration that starts out at the given slope where it can
+    // and eases into `to`.  It's a cubic Hermite curve sampled into maxKeyframes keyframes.  The first segment
+    // is linear, so the ramp leaves at the curve's initial slope, and the rest are played back with Hermite
+    // easing.  A slope heading away from `to` is dropped and a steep one is capped at three times the ramp's
+    // average, which keeps the curve monotone, so every sample lies between `from` and `to` as well as
+    // within [minValue, maxValue].
+    template <typename T, size_t maxKeyframes = 8>
+    constexpr ESCOperation<T, maxKeyframes> blendedRamp(const char* name, T from, ESCOperationSlope slope, T to, UsTime duration, T minValue,
+                                                        T maxValue) {
+        ESCOperation<T, maxKeyframes> operation(name, {{0_us, from}}, true);
+        if (duration <= 0_us) {
+            operation._speeds[0].second = to;
+            return operation;
+        }
+        if (from == to) {
+            operation._speeds.push_back({duration, to});
+            return operation;
+        }
+
+        const int64_t change = static_cast<int64_t>(to) - static_cast<int64_t>(from);
+        const int64_t maxTangent = 3 * (change < 0 ? -change : change);
+        int64_t startTangent = slope.duration > 0_us ? slope.change * duration.count() / slope.duration.count() : 0;
+        startTangent = (startTangent < 0) != (change < 0) ? 0 : std::clamp<int64_t>(startTangent, -maxTangent, maxTangent);
+
+        const int64_t upper = std::min<int64_t>(std::max(from, to), maxValue);
+        const int64_t lower = std::min<int64_t>(std::max<int64_t>(std::min(from, to), minValue), upper);
+
+        // With s = i / n, the curve is (2s^3 - 3s^2 + 1) * from + (s^3 - 2s^2 + s) * startTangent + (3s^2 - 2s^3) * to,
+        // scaled through by n^3 to stay in integers.
+        constexpr int64_t n = maxKeyframes - 1;
+        for (int64_t i = 1; i < n; ++i) {
+            const int64_t i2 = i * i;
+            const int64_t i3 = i2 * i;
+            const int64_t value = ((2 * i3 - 3 * i2 * n + n * n * n) * static_cast<int64_t>(from) + (i3 - 2 * i2 * n + i * n * n) * startTangent +
+                                   (3 * i2 * n - 2 * i3) * static_cast<int64_t>(to)) /
+                                  (n * n * n);
+            operation._speeds.push_back({UsTime(duration.count() * i / n), static_cast<T>(std::clamp(value, lower, upper))});
         }
+        operation._speeds.push_back({duration, to});
+        return operation.withEasing(ESCEasing::Hermite).withEasing(1, ESCEasing::Linear);
+    }
 
-        return value;
+    template <typename T, size_t maxKeyframes>
+    constexpr bool isMonotoneBetween(const ESCOperation<T, maxKeyframes>& operation, T from, T to) {
+        for (size_t i = 0; i < operation._speeds.size(); ++i) {
+            const T value = operation._speeds[i].second;
+            const T previous = i == 0 ? from : operation._speeds[i - 1].second;
+            if (value < std::min(from, to) || value > std::max(from, to) || (from < to ? value < previous : value > previous)) {
+                return false;
+            }
+        }
+        return true;
     }
+
+    static_assert(blendedRamp<int32_t>("", 100, {}, 200, 7_ms, 0, 1000)._speeds.back() == std::make_pair(UsTime(7_ms), 200));
+    static_assert(blendedRamp<int32_t>("", 100, {}, 200, 7_ms, 0, 1000)._speeds[0].second == 100);
+    // Cancelled while climbing steeply, for a lower target: the old slope is dropped rather than overshooting.
+    static_assert(isMonotoneBetween(blendedRamp<int32_t>("", 1500, {.change = 500, .duration = 1_ms}, 1000, 7_ms, 1000, 2000), 1500, 1000));
+    // Cancelled while falling far faster than the new ramp: the slope is capped rather than undershooting.
+    static_assert(isMonotoneBetween(blendedRamp<int32_t>("", 1500, {.change = -5000, .duration = 1_ms}, 1000, 7_ms, 1000, 2000), 1500, 1000));
+    // A shallower slope in the same direction is kept, so the ramp leaves faster than it would from rest.
+    static_assert(blendedRamp<int32_t>("", 100, {.change = 20, .duration = 1_ms}, 200, 7_ms, 0, 1000)._speeds[1].second >
+                  blendedRamp<int32_t>("", 100, {}, 200, 7_ms, 0, 1000)._speeds[1].second);
 }  // namespace pcp
@@ -0,0 +1,144 @@
+#include "ESC/ESCPWMTimer.hpp"
+
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace pcp {
+    static constexpr uint32_t kTimerInterruptPriority = 3;
+
+    bool _escPWMTimerEmpty(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
+    static bool _escPWMTimerStopped(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
+
+    template <ESCProtocol protocol>
+    static mcpwm_timer_config_t timerConfigFor(void) {
+        using Timing = ESCProtocolTiming<protocol>;
+        return {.group_id = ESCPWMTimer::kGroupID,
+                .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
+                .resolution_hz = Timing::kTimerResolutionHz,
+                .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
+                .period_ticks = Timing::kFramePeriodTicks,
+                .intr_priority = kTimerInterruptPriority,
+                .flags = {
+                    .update_period_on_empty = false,
+                    .update_period_on_sync = false,
+                    .allow_pd = false,
+                }};
+    }
+
+    static mcpwm_timer_config_t timerConfig(ESCProtocol protocol) {
+        switch (protocol) {
+            case ESCProtocol::PWM50: return timerConfigFor<ESCProtocol::PWM50>();
+            case ESCProtocol::PWM400: return timerConfigFor<ESCProtocol::PWM400>();
+            case ESCProtocol::OneShot125: return timerConfigFor<ESCProtocol::OneShot125>();
+            case ESCProtocol::OneShot42: return timerConfigFor<ESCProtocol::OneShot42>();
+            case ESCProtocol::Multishot: return timerConfigFor<ESCProtocol::Multishot>();
+            case ESCProtocol::DShot150:  // fallthrough
+            case ESCProtocol::DShot300:  // fallthrough
+            case ESCProtocol::DShot600: break;
+        }
+        assert(false && "ESCPWMTimer only drives pulse width protocols");
+        return timerConfigFor<ESCProtocol::PWM50>();
+    }
+
+    ESCPWMTimer::ESCPWMTimer(ESCProtocol protocol) : _protocol(protocol) {
+        esp_err_t err = ESP_OK;
+
+        const mcpwm_timer_config_t config = timerConfig(protocol);
+        err = mcpwm_new_timer(&config, &_timerHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while creating timer: %s", esp_err_to_name(err));
+            return;
+        }
+
+        mcpwm_timer_event_callbacks_t timerCallbacks = {
+            .on_full = nullptr,
+            .on_empty = _escPWMTimerEmpty,
+            .on_stop = _escPWMTimerStopped,
+        };
+        err = mcpwm_timer_register_event_callbacks(_timerHandle, &timerCallbacks, this);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while setting up timer callbacks: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = mcpwm_timer_enable(_timerHandle);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while enabling timer: %s", esp_err_to_name(err));
+            return;
+        }
+    }
+
+    ESCPWMTimer::~ESCPWMTimer() {
+        if (_timerHandle == nullptr) {
+            return;
+        }
+        mcpwm_timer_disable(_timerHandle);
+        mcpwm_del_timer(_timerHandle);
+    }
+
+    bool ESCPWMTimer::attach(ESCPWMTimerChannel* channel) {
+        portENTER_CRITICAL(&_channelsLock);
+        auto slot = std::find(_channels.begin(), _channels.end(), nullptr);
+        const bool attached = slot != _channels.end();
+        if (attached) {
+            *slot = channel;
+        }
+        portEXIT_CRITICAL(&_channelsLock);
+        return attached;
+    }
+
+    // Once this returns the ISR won't touch channel again, so it can be torn down.
+    void ESCPWMTimer::detach(ESCPWMTimerChannel* channel) {
+        portENTER_CRITICAL(&_channelsLock);
+        std::replace(_channels.begin(), _channels.end(), channel, (ESCPWMTimerChannel*)nullptr);
+        portEXIT_CRITICAL(&_channelsLock);
+    }
+
+    void ESCPWMTimer::start(void) {
+        std::lock_guard<std::mutex> guard(_runningMutex);
+        if (_runningChannels++ > 0) {
+            return;
+        }
+
+        esp_err_t err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_START_NO_STOP);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while starting timer: %s", esp_err_to_name(err));
+        }
+    }
+
+    void ESCPWMTimer::stop(void) {
+        std::lock_guard<std::mutex> guard(_runningMutex);
+        assert(_runningChannels > 0);
+        if (--_runningChannels > 0) {
+            return;
+        }
+
+        esp_err_t err = mcpwm_timer_start_stop(_timerHandle, MCPWM_TIMER_STOP_EMPTY);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error occurred while stopping timer: %s", esp_err_to_name(err));
+        }
+    }
+
+    bool ESCPWMTimer::_timerEmpty(void) {
+        bool higherPriorityTaskWoken = false;
+        portENTER_CRITICAL_ISR(&_channelsLock);
+        for (ESCPWMTimerChannel* channel : _channels) {
+            if (channel != nullptr) {
+                higherPriorityTaskWoken |= channel->advanceFrame();
+            }
+        }
+        portEXIT_CRITICAL_ISR(&_channelsLock);
+        return higherPriorityTaskWoken;
+    }
+
+    bool _escPWMTimerEmpty(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx) {
+        ESCPWMTimer* pwmTimer = reinterpret_cast<ESCPWMTimer*>(user_ctx);
+        return pwmTimer->_timerEmpty();
+    }
+
+    static bool _escPWMTimerStopped(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx) {
+        PCP_DRAM_LOGW("Timer Stopped!");
+        return false;
+    }
+}  // namespace pcp
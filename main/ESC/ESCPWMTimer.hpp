@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ESC/ESCProtocol.hpp"
+
+#include "driver/mcpwm_timer.h"
+#include "soc/soc_caps.h"
+
+#include "freertos/FreeRTOS.h"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace pcp {
+    // Something driven from an ESCPWMTimer's frame interrupt.
+    class ESCPWMTimerChannel {
+    public:
+        virtual ~ESCPWMTimerChannel() {}
+
+        // Called from the timer ISR at the start of every frame.  Returns true if a higher priority task
+        // was woken.
+        virtual bool advanceFrame(void) = 0;
+    };
+
+    // An MCPWM timer running at a PWM protocol's frame rate, shared by up to one ESC per MCPWM operator.
+    // Every ESC's pulse starts on the same timer tick, so outputs stay phase aligned, and one interrupt
+    // per frame updates all of them.  The timer runs while any ESC sharing it is armed.
+    class ESCPWMTimer {
+    public:
+        static constexpr size_t kMaxChannels = SOC_MCPWM_OPERATORS_PER_GROUP;
+        static constexpr int kGroupID = 0;
+
+        explicit ESCPWMTimer(ESCProtocol protocol);
+        ~ESCPWMTimer();
+
+        ESCProtocol protocol(void) const { return _protocol; }
+        mcpwm_timer_handle_t handle(void) const { return _timerHandle; }
+
+        // Returns false if every operator is already in use.
+        bool attach(ESCPWMTimerChannel* channel);
+        void detach(ESCPWMTimerChannel* channel);
+
+        void start(void);
+        void stop(void);
+
+    private:
+        bool _timerEmpty(void);
+
+        friend bool _escPWMTimerEmpty(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t* edata, void* user_ctx);
+
+        const ESCProtocol _protocol;
+        mcpwm_timer_handle_t _timerHandle = nullptr;
+
+        // Guarded by _channelsLock, as the ISR walks it.
+        portMUX_TYPE _channelsLock = portMUX_INITIALIZER_UNLOCKED;
+        std::array<ESCPWMTimerChannel*, kMaxChannels> _channels{};
+
+        std::mutex _runningMutex;
+        size_t _runningChannels = 0;
+    };
+}  // namespace pcp
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Utilities/Time.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace pcp {
+    // The throttle protocols understood by BLHeli ESCs.  The analog (pulse width) ones are driven by
+    // ESCControlSchemePWM, the digital DShot ones by ESCControlSchemeDShot.
+    enum class ESCProtocol : uint8_t {
+        PWM50 = 0,
+        PWM400 = 1,
+        OneShot125 = 2,
+        OneShot42 = 3,
+        Multishot = 4,
+        DShot150 = 5,
+        DShot300 = 6,
+        DShot600 = 7,
+    };
+
+    constexpr bool isDShot(ESCProtocol protocol) {
+        return protocol == ESCProtocol::DShot150 || protocol == ESCProtocol::DShot300 || protocol == ESCProtocol::DShot600;
+    }
+
+    inline std::string to_string(ESCProtocol protocol) {
+        switch (protocol) {
+            case ESCProtocol::PWM50: return "PWM (50Hz)";
+            case ESCProtocol::PWM400: return "PWM (400Hz)";
+            case ESCProtocol::OneShot125: return "OneShot125";
+            case ESCProtocol::OneShot42: return "OneShot42";
+            case ESCProtocol::Multishot: return "Multishot";
+            case ESCProtocol::DShot150: return "DShot150";
+            case ESCProtocol::DShot300: return "DShot300";
+            case ESCProtocol::DShot600: return "DShot600";
+        }
+        return "<Unknown Protocol>";
+    }
+
+    // The pulse widths an analog ESC treats as zero and full throttle, in 1-2ms PWM terms.  ESCs scale
+    // them onto the faster protocols' ranges, so one pair describes an ESC whichever protocol drives it.
+    struct ESCThrottleEndpoints {
+        UsTime min = 1000_us;
+        UsTime max = 2000_us;
+
+        constexpr bool operator==(const ESCThrottleEndpoints& other) const = default;
+    };
+
+    // How an analog ESC is armed.  A cold arm plays the full sequence, a step at a time, for an ESC in an
+    // unknown state.  An ESC that was armed until recently only needs to see zero throttle for a moment
+    // before it follows the throttle again, so that's all a warm arm sends.
+    struct ESCArmProfile {
+        UsTime coldStep = 500_ms;
+        UsTime warmHold = 300_ms;
+        // How long after disarming an ESC can still be treated as warm.
+        UsTime warmWindow = 5000_ms;
+
+        constexpr bool operator==(const ESCArmProfile& other) const = default;
+    };
+
+    template <ESCProtocol protocol>
+    struct ESCProtocolParameters {};
+
+    template <>
+    struct ESCProtocolParameters<ESCProtocol::PWM50> {
+        static constexpr uint32_t kTimerResolutionHz = 1'000'000;
+        static constexpr uint32_t kFramePeriodNs = 20'000'000;
+        static constexpr uint32_t kMinPulseNs = 1'000'000;
+        static constexpr uint32_t kMaxPulseNs = 2'000'000;
+    };
+
+    template <>
+    struct ESCProtocolParameters<ESCProtocol::PWM400> {
+        static constexpr uint32_t kTimerResolutionHz = 10'000'000;
+        static constexpr uint32_t kFramePeriodNs = 2'500'000;
+        static constexpr uint32_t kMinPulseNs = 1'000'000;
+        static constexpr uint32_t kMaxPulseNs = 2'000'000;
+    };
+
+    template <>
+    struct ESCProtocolParameters<ESCProtocol::OneShot125> {
+        static constexpr uint32_t kTimerResolutionHz = 40'000'000;
+        static constexpr uint32_t kFramePeriodNs = 500'000;
+        static constexpr uint32_t kMinPulseNs = 125'000;
+        static constexpr uint32_t kMaxPulseNs = 250'000;
+    };
+
+    template <>
+    struct ESCProtocolParameters<ESCProtocol::OneShot42> {
+        static constexpr uint32_t kTimerResolutionHz = 40'000'000;
+        static constexpr uint32_t kFramePeriodNs = 200'000;
+        static constexpr uint32_t kMinPulseNs = 41'667;
+        static constexpr uint32_t kMaxPulseNs = 83'333;
+    };
+
+    template <>
+    struct ESCProtocolParameters<ESCProtocol::Multishot> {
+        static constexpr uint32_t kTimerResolutionHz = 40'000'000;
+        static constexpr uint32_t kFramePeriodNs = 50'000;
+        static constexpr uint32_t kMinPulseNs = 5'000;
+        static constexpr uint32_t kMaxPulseNs = 25'000;
+    };
+
+    // Everything the MCPWM timer needs for a protocol, in timer ticks.
+    template <ESCProtocol protocol>
+    struct ESCProtocolTiming {
+        using Parameters = ESCProtocolParameters<protocol>;
+
+        using Ticks = TimerTicks<Parameters::kTimerResolutionHz>;
+
+        static constexpr uint32_t kTimerResolutionHz = Parameters::kTimerResolutionHz;
+        static constexpr UsTime kFramePeriod = checkedDurationCast<UsTime>(NsTime(Parameters::kFramePeriodNs));
+        static constexpr uint32_t kFramePeriodTicks = checkedDurationCast<Ticks>(kFramePeriod).count();
+        // Pulse widths that aren't a whole number of ticks (e.g. OneShot42's) are deliberately rounded down.
+        static constexpr int32_t kMinThrottleTicks = std::chrono::duration_cast<Ticks>(NsTime(Parameters::kMinPulseNs)).count();
+        static constexpr int32_t kMaxThrottleTicks = std::chrono::duration_cast<Ticks>(NsTime(Parameters::kMaxPulseNs)).count();
+
+        // The output stage alone: from the comparator being written to the ESC having seen the new pulse.
+        // The value waits in the shadow register for the start of the next frame (at most a whole frame) and
+        // is fully described once that pulse falls.  Setpoints reach the comparator from the timer-empty ISR
+        // at the start of a frame, so through ESC::setThrottle() add up to one more frame, plus that ISR's
+        // interrupt latency.  Anything upstream (the fan input ISR, waking the control task) isn't counted.
+        static constexpr uint32_t kWorstCaseLatencyNs = Parameters::kFramePeriodNs + Parameters::kMaxPulseNs;
+
+        // An endpoint in 1-2ms PWM terms, scaled onto this protocol's pulse widths the way BLHeli does.
+        static constexpr int32_t throttleTicks(UsTime standardPulse) {
+            return kMinThrottleTicks + (int32_t)((standardPulse - 1000_us).count() * (kMaxThrottleTicks - kMinThrottleTicks) / 1000);
+        }
+
+        static_assert(kFramePeriodTicks <= 0xffff, "MCPWM timers only have 16 bit periods");
+        static_assert(kMaxThrottleTicks < kFramePeriodTicks, "Pulses must fit inside a frame");
+        static_assert(kMaxThrottleTicks - kMinThrottleTicks >= 100, "Protocols need at least 1% throttle resolution");
+    };
+
+    static_assert(ESCProtocolTiming<ESCProtocol::OneShot125>::throttleTicks(1000_us) == ESCProtocolTiming<ESCProtocol::OneShot125>::kMinThrottleTicks);
+    static_assert(ESCProtocolTiming<ESCProtocol::OneShot125>::throttleTicks(2000_us) == ESCProtocolTiming<ESCProtocol::OneShot125>::kMaxThrottleTicks);
+
+    template <ESCProtocol protocol>
+    struct DShotParameters {};
+
+    template <>
+    struct DShotParameters<ESCProtocol::DShot150> {
+        static constexpr uint32_t kBitRate = 150'000;
+        static constexpr uint32_t kFramePeriodNs = 250'000;
+        static constexpr uint32_t kBidirectionalFramePeriodNs = 500'000;
+    };
+
+    template <>
+    struct DShotParameters<ESCProtocol::DShot300> {
+        static constexpr uint32_t kBitRate = 300'000;
+        static constexpr uint32_t kFramePeriodNs = 125'000;
+        static constexpr uint32_t kBidirectionalFramePeriodNs = 250'000;
+    };
+
+    template <>
+    struct DShotParameters<ESCProtocol::DShot600> {
+        static constexpr uint32_t kBitRate = 600'000;
+        static constexpr uint32_t kFramePeriodNs = 62'500;
+        static constexpr uint32_t kBidirectionalFramePeriodNs = 125'000;
+    };
+
+    // Everything the RMT channel needs for a DShot protocol, in RMT ticks.  A one bit is high for 3/4 of
+    // the bit period and a zero bit for 3/8 of it.  Bidirectional DShot frames are spaced further apart to
+    // leave room for the ESC's reply: 21 GCR bits at 5/4 of the bit rate, ~30us after our frame ends.
+    template <ESCProtocol protocol>
+    struct DShotTiming {
+        using Parameters = DShotParameters<protocol>;
+
+        static constexpr uint32_t kResolutionHz = 40'000'000;
+        static constexpr uint32_t kBitsPerFrame = 16;
+
+        using Ticks = TimerTicks<kResolutionHz>;
+
+        static constexpr uint32_t kBitTicks = (kResolutionHz + Parameters::kBitRate / 2) / Parameters::kBitRate;
+        static constexpr uint32_t kOneHighTicks = (kBitTicks * 3) / 4;
+        static constexpr uint32_t kZeroHighTicks = (kBitTicks * 3) / 8;
+        static constexpr uint32_t kFrameTicks = kBitTicks * kBitsPerFrame;
+        static constexpr uint32_t kFramePeriodTicks = checkedDurationCast<Ticks>(NsTime(Parameters::kFramePeriodNs)).count();
+        static constexpr uint32_t kFrameGapTicks = kFramePeriodTicks - kFrameTicks;
+        static constexpr uint32_t kBidirectionalFramePeriodTicks = checkedDurationCast<Ticks>(NsTime(Parameters::kBidirectionalFramePeriodNs)).count();
+        static constexpr uint32_t kBidirectionalFrameGapTicks = kBidirectionalFramePeriodTicks - kFrameTicks;
+
+        static constexpr uint32_t kReplyBits = 21;
+        static constexpr uint32_t kReplyBitTicks = (kResolutionHz * 4 + Parameters::kBitRate * 5 / 2) / (Parameters::kBitRate * 5);
+        static constexpr uint32_t kReplyBitNs = std::chrono::duration_cast<NsTime>(Ticks(kReplyBitTicks)).count();
+        static constexpr uint32_t kReplyTurnaroundTicks = checkedDurationCast<Ticks>(30_us).count();
+
+        // The output stage alone: the frame being sent when the channel is restarted is abandoned, and the
+        // new one takes at most a whole frame period to go out.  The scheme's task does the restart, so
+        // through ESC::setThrottle() add the time to wake it, which depends on what else is running at or
+        // above its priority.  Anything upstream (the fan input ISR, waking the control task) isn't counted.
+        static constexpr uint32_t kWorstCaseLatencyNs = Parameters::kFramePeriodNs;
+
+        static_assert(kFrameTicks < kFramePeriodTicks, "DShot frames must fit inside the frame period");
+        static_assert(kFrameGapTicks < 2 * 0x7fff, "The inter frame gap must fit in a single RMT symbol");
+        static_assert(kFrameTicks + kReplyTurnaroundTicks + kReplyBits * kReplyBitTicks < kBidirectionalFramePeriodTicks,
+                      "Bidirectional DShot frames must leave room for the ESC's reply");
+        static_assert(kBidirectionalFrameGapTicks < 2 * 0x7fff, "The inter frame gap must fit in a single RMT symbol");
+    };
+
+    // The output stage latency of protocol, see kWorstCaseLatencyNs for what it leaves out.
+    inline uint32_t worstCaseSetpointLatencyNs(ESCProtocol protocol) {
+        switch (protocol) {
+            case ESCProtocol::PWM50: return ESCProtocolTiming<ESCProtocol::PWM50>::kWorstCaseLatencyNs;
+            case ESCProtocol::PWM400: return ESCProtocolTiming<ESCProtocol::PWM400>::kWorstCaseLatencyNs;
+            case ESCProtocol::OneShot125: return ESCProtocolTiming<ESCProtocol::OneShot125>::kWorstCaseLatencyNs;
+            case ESCProtocol::OneShot42: return ESCProtocolTiming<ESCProtocol::OneShot42>::kWorstCaseLatencyNs;
+            case ESCProtocol::Multishot: return ESCProtocolTiming<ESCProtocol::Multishot>::kWorstCaseLatencyNs;
+            case ESCProtocol::DShot150: return DShotTiming<ESCProtocol::DShot150>::kWorstCaseLatencyNs;
+            case ESCProtocol::DShot300: return DShotTiming<ESCProtocol::DShot300>::kWorstCaseLatencyNs;
+            case ESCProtocol::DShot600: return DShotTiming<ESCProtocol::DShot600>::kWorstCaseLatencyNs;
+        }
+        return 0;
+    }
+}  // namespace pcp
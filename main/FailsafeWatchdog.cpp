@@ -0,0 +1,130 @@
+#include "FailsafeWatchdog.hpp"
+
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace pcp {
+    static constexpr uint32_t kWatchdogResolutionHz = 1'000'000;
+    static constexpr int kWatchdogInterruptPriority = 3;
+
+    bool failsafeWatchdogAlarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t* edata, void* userData);
+
+    FailsafeWatchdog::FailsafeWatchdog(ESC& esc, UsTime deadline, uint8_t failsafeThrottle)
+        : _esc(esc), _deadline(deadline), _failsafeThrottle(failsafeThrottle) {
+        esp_err_t err = ESP_OK;
+
+        gptimer_config_t timerConfig = {.clk_src = GPTIMER_CLK_SRC_DEFAULT,
+                                        .direction = GPTIMER_COUNT_UP,
+                                        .resolution_hz = kWatchdogResolutionHz,
+                                        .intr_priority = kWatchdogInterruptPriority,
+                                        .flags = {
+                                            .intr_shared = false,
+                                            .allow_pd = false,
+                                            .backup_before_sleep = false,
+                                        }};
+        err = gptimer_new_timer(&timerConfig, &_timer);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error creating watchdog timer: %s", esp_err_to_name(err));
+            return;
+        }
+
+        gptimer_alarm_config_t alarmConfig = {.alarm_count = static_cast<uint64_t>(std::max(_deadline / 4, 1_us).count()),
+                                              .reload_count = 0,
+                                              .flags = {
+                                                  .auto_reload_on_alarm = true,
+                                              }};
+        err = gptimer_set_alarm_action(_timer, &alarmConfig);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error setting watchdog alarm: %s", esp_err_to_name(err));
+            return;
+        }
+
+        gptimer_event_callbacks_t callbacks = {.on_alarm = failsafeWatchdogAlarm};
+        err = gptimer_register_event_callbacks(_timer, &callbacks, this);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error setting watchdog callbacks: %s", esp_err_to_name(err));
+            return;
+        }
+
+        err = gptimer_enable(_timer);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error enabling watchdog timer: %s", esp_err_to_name(err));
+        }
+    }
+
+    FailsafeWatchdog::~FailsafeWatchdog() {
+        stop();
+        if (_timer != nullptr) {
+            gptimer_disable(_timer);
+            gptimer_del_timer(_timer);
+        }
+    }
+
+    void FailsafeWatchdog::start(void) {
+        if (_started || _timer == nullptr) {
+            return;
+        }
+
+        _lastFeed.store(wrappingUsTimestamp(EspTimerClock::now()), std::memory_order_relaxed);
+        esp_err_t err = gptimer_start(_timer);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error starting watchdog timer: %s", esp_err_to_name(err));
+            return;
+        }
+        _started = true;
+    }
+
+    void FailsafeWatchdog::stop(void) {
+        if (!_started) {
+            return;
+        }
+
+        esp_err_t err = gptimer_stop(_timer);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error stopping watchdog timer: %s", esp_err_to_name(err));
+        }
+        _started = false;
+        feed();
+    }
+
+    bool FailsafeWatchdog::feed(void) {
+        const WrappingUsTimestamp now = wrappingUsTimestamp(EspTimerClock::now());
+        _recordGap(wrappingUsElapsed(_lastFeed.exchange(now, std::memory_order_relaxed), now));
+
+        if (!_tripped.exchange(false, std::memory_order_relaxed)) {
+            return false;
+        }
+
+        _esc.releaseFailsafe();
+        PCP_LOGW("Failsafe released");
+        return true;
+    }
+
+    // Called from the timer ISR every quarter of the deadline.
+    bool FailsafeWatchdog::_check(void) {
+        const UsTime gap = wrappingUsElapsed(_lastFeed.load(std::memory_order_relaxed), wrappingUsTimestamp(EspTimerClock::now()));
+        _recordGap(gap);
+        if (gap <= _deadline || _tripped.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        // Engaged before it's marked tripped, so a feed() racing on the other core can't release it first.
+        const bool higherPriorityTaskWoken = _esc.engageFailsafeFromISR(_failsafeThrottle);
+        _tripCount.fetch_add(1, std::memory_order_relaxed);
+        _tripped.store(true, std::memory_order_relaxed);
+        PCP_DRAM_LOGW("Failsafe tripped after %lldus without a setpoint", (long long)gap.count());
+        return higherPriorityTaskWoken;
+    }
+
+    void FailsafeWatchdog::_recordGap(UsTime gap) {
+        const uint32_t gapUs = static_cast<uint32_t>(gap.count());
+        uint32_t worst = _worstGapUs.load(std::memory_order_relaxed);
+        while (gapUs > worst && !_worstGapUs.compare_exchange_weak(worst, gapUs, std::memory_order_relaxed)) {}
+    }
+
+    bool failsafeWatchdogAlarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t* edata, void* userData) {
+        FailsafeWatchdog* watchdog = reinterpret_cast<FailsafeWatchdog*>(userData);
+        return watchdog->_check();
+    }
+}  // namespace pcp
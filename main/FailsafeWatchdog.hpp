@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ESC/ESC.hpp"
+#include "Utilities/Time.hpp"
+
+#include "driver/gptimer.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace pcp {
+    // Watches the control path from a hardware timer interrupt, so it keeps working however badly tasks
+    // (the UI, the display lock, the controller itself) are stuck.  If feed() isn't called for longer than
+    // the deadline the ESC is held at the failsafe throttle, and the next feed() releases it.  A trip is
+    // noticed within a quarter of the deadline, and the ESC's output follows within a frame.
+    class FailsafeWatchdog {
+    public:
+        FailsafeWatchdog(ESC& esc, UsTime deadline, uint8_t failsafeThrottle);
+        ~FailsafeWatchdog();
+
+        void start(void);
+        void stop(void);
+
+        // Call whenever a fresh setpoint has been delivered.  Returns true if this released a trip, in which
+        // case the ESC is back to following setpoints and the current one should be resent.
+        bool feed(void);
+
+        // How often feed() needs calling to stay comfortably inside the deadline.
+        UsTime feedInterval(void) const { return _deadline / 2; }
+
+        bool tripped(void) const { return _tripped.load(std::memory_order_relaxed); }
+        uint32_t tripCount(void) const { return _tripCount.load(std::memory_order_relaxed); }
+        // The longest time between feeds since starting, including any gap still ongoing.
+        UsTime worstGap(void) const { return UsTime(_worstGapUs.load(std::memory_order_relaxed)); }
+
+    private:
+        bool _check(void);
+        void _recordGap(UsTime gap);
+
+        friend bool failsafeWatchdogAlarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t* edata, void* userData);
+
+        ESC& _esc;
+        const UsTime _deadline;
+        const uint8_t _failsafeThrottle;
+
+        gptimer_handle_t _timer = nullptr;
+        bool _started = false;
+
+        std::atomic<WrappingUsTimestamp> _lastFeed = 0;
+        std::atomic<bool> _tripped = false;
+        std::atomic<uint32_t> _tripCount = 0;
+        std::atomic<uint32_t> _worstGapUs = 0;
+    };
+}  // namespace pcp
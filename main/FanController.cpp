@@ -0,0 +1,136 @@
+#include "FanController.hpp"
+
+#include "Log.hpp"
+#include "Utilities/Time.hpp"
+#include "Utilities/freeRTOSErrorString.hpp"
+
+namespace pcp {
+    // Above the ESC throttle update task, so a new setpoint is handed over as soon as it's measured.
+    static constexpr UBaseType_t kControlTaskPriority = 12;
+    // How often the sample ring is drained when the input isn't changing, well inside the time it takes a
+    // 25kHz input to fill it.  A measured RPM is passed on to the tacho output at the same rate.
+    static constexpr MsTime kSampleDrainPeriod = 10_ms;
+    static constexpr MsTime kFailsafeDeadline = MsTime(CONFIG_PCP_FAILSAFE_DEADLINE_MS);
+    static constexpr uint8_t kFailsafeThrottle = CONFIG_PCP_FAILSAFE_THROTTLE;
+
+    void fanControllerTask(void* userInfo) {
+        FanController* controller = reinterpret_cast<FanController*>(userInfo);
+        controller->_task();
+    }
+
+    FanController::FanController(FanInput& fanInput, ESC& esc) : _fanInput(fanInput), _esc(esc), _watchdog(esc, kFailsafeDeadline, kFailsafeThrottle) {
+        // Only the most recent fan input matters, there's no point playing out every intermediate one.
+        _esc.setSetpointMode(ESCSetpointMode::LatestWins);
+
+        BaseType_t err = xTaskCreate(fanControllerTask, "Fan Control Task", 4096, this, kControlTaskPriority, &_controlTask);
+        if (err != pdPASS) {
+            PCP_LOGE("Fan control task creation failed: %s", freeRTOSErrorString(err));
+        }
+    }
+
+    FanController::~FanController() {
+        stop();
+        if (_controlTask != nullptr) {
+            vTaskDelete(_controlTask);
+        }
+    }
+
+    void FanController::start(void) {
+        _running = true;
+        _fanInput.setObserverTask(_controlTask);
+        _watchdog.start();
+        refresh();
+    }
+
+    void FanController::stop(void) {
+        _fanInput.setObserverTask(nullptr);
+        _running = false;
+        _watchdog.stop();
+        _setpoint = -1;
+    }
+
+    void FanController::refresh(void) {
+        if (_controlTask != nullptr) {
+            xTaskNotifyGive(_controlTask);
+        }
+    }
+
+    std::optional<uint8_t> FanController::setpoint(void) const {
+        const int16_t setpoint = _setpoint.load();
+        return setpoint < 0 ? std::optional<uint8_t>() : std::optional<uint8_t>(static_cast<uint8_t>(setpoint));
+    }
+
+    // Wakes at least every watchdog feed interval, even if the input is steady, to show it's still alive.
+    // The watchdog's only fed while the input's last reading is fresh, so waking on time isn't enough on its
+    // own: a stalled capture channel and saturation check starve it too.
+    void FanController::_task(void) {
+        while (true) {
+            const UsTime wakeInterval = std::min<UsTime>(kSampleDrainPeriod, _watchdog.feedInterval());
+            ulTaskNotifyTake(pdTRUE, ticksToWait(wakeInterval));
+            // Drained even while stopped, so the ring never holds periods from before a start.  If nothing's been
+            // captured since the last wake (a held line, or a signal slower than the wake interval) the FanInput's
+            // own filtered value is used, which its saturation check sets to 0% or 100%.
+            _inputDutyCycle = _drainDutyCyclePercentage().value_or(_fanInput.dutyCyclePercentage());
+            if (_running) {
+                _applySetpoint();
+                _reportRPM();
+                const WrappingUsTimestamp now = wrappingUsTimestamp(EspTimerClock::now());
+                if (wrappingUsElapsed(_fanInput.lastInputTime(), now) > FanInput::kInputStaleAfter) {
+                    continue;
+                }
+                if (_watchdog.feed()) {
+                    // The failsafe held the ESC somewhere else, so the setpoint needs sending again.
+                    _setpoint = -1;
+                    _applySetpoint();
+                }
+            }
+        }
+    }
+
+    void FanController::_applySetpoint(void) {
+        if (!_esc.isArmed()) {
+            _setpoint = -1;
+            if (_tachoOutput != nullptr) {
+                _tachoOutput->setThrottle(0);
+            }
+            return;
+        }
+
+        const uint8_t dutyCycle = _inputDutyCycle;
+        if (_setpoint.exchange(dutyCycle) != dutyCycle) {
+            _esc.setThrottle(dutyCycle);
+            if (_tachoOutput != nullptr && !_esc.rpm().has_value()) {
+                _tachoOutput->setThrottle(dutyCycle);
+            }
+        }
+    }
+
+    // The time weighted average of every period in the ring, or nothing if it's empty.
+    std::optional<uint8_t> FanController::_drainDutyCyclePercentage(void) {
+        uint64_t onTime = 0;
+        uint64_t period = 0;
+        size_t drained = 0;
+        while ((drained = _fanInput.drainSamples(_sampleBatch.data(), _sampleBatch.size())) > 0) {
+            for (size_t i = 0; i < drained; i++) {
+                onTime += _sampleBatch[i].onTime;
+                period += _sampleBatch[i].period;
+            }
+        }
+
+        if (period == 0) {
+            return std::optional<uint8_t>();
+        }
+        return static_cast<uint8_t>(std::min<uint64_t>((onTime * 100 + period / 2) / period, 100));
+    }
+
+    void FanController::_reportRPM(void) {
+        if (_tachoOutput == nullptr) {
+            return;
+        }
+
+        const std::optional<uint32_t> rpm = _esc.rpm();
+        if (rpm.has_value() && rpm.value() != _tachoOutput->rpm()) {
+            _tachoOutput->setRPM(rpm.value());
+        }
+    }
+}  // namespace pcp
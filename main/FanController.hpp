@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ESC/ESC.hpp"
+#include "FailsafeWatchdog.hpp"
+#include "FanInput.hpp"
+#include "FanTachoOutput.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+namespace pcp {
+    // Drives an ESC from a FanInput.  A dedicated high priority task sleeps until the FanInput notifies it
+    // that the filtered duty cycle has changed and then pushes the new setpoint straight to the ESC, so the
+    // latency from the fan header to the motor doesn't depend on how often (or how slowly) the UI updates.
+    // The setpoint is the average duty cycle over every period captured since the task last ran, drained
+    // from the FanInput's sample ring in batches, so no period is skipped however fast the signal is.
+    // A FailsafeWatchdog fed by the task takes over the ESC if the task ever stops delivering setpoints, or
+    // if the input stops producing readings.  A line held at one level still reads as 0% or 100%.
+    class FanController {
+    public:
+        FanController(FanInput& fanInput, ESC& esc);
+        ~FanController();
+
+        void start(void);
+        void stop(void);
+
+        // If set, the tacho output reports the ESC's measured RPM, or every setpoint sent to the ESC if it
+        // doesn't measure one.
+        void setTachoOutput(FanTachoOutput* tachoOutput) { _tachoOutput = tachoOutput; }
+
+        // Forces the current input to be re-applied, e.g. once the ESC has finished arming.
+        void refresh(void);
+
+        std::optional<uint8_t> setpoint(void) const;
+
+        const FailsafeWatchdog& watchdog(void) const { return _watchdog; }
+
+    private:
+        void _task(void);
+        void _applySetpoint(void);
+        std::optional<uint8_t> _drainDutyCyclePercentage(void);
+        void _reportRPM(void);
+
+        FanInput& _fanInput;
+        ESC& _esc;
+        FanTachoOutput* _tachoOutput = nullptr;
+        FailsafeWatchdog _watchdog;
+
+        TaskHandle_t _controlTask = nullptr;
+        std::atomic<bool> _running = false;
+        std::atomic<int16_t> _setpoint = -1;
+        // Room for one batch of samples at a time, kept here rather than on the task's stack.
+        std::array<FanInputSample, 64> _sampleBatch;
+        uint8_t _inputDutyCycle = 0;
+
+        friend void fanControllerTask(void* userInfo);
+    };
+}  // namespace pcp
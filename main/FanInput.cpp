@@ -5,8 +5,10 @@
 #include "Pins.hpp"
 
 namespace pcp {
-    static constexpr uint64_t kPWMTimeoutCheckFrequency = 1'000'000 / 30;
-    static constexpr uint64_t kPWMTimeout = 1'000'000 / 12'500;
+    static constexpr UsTime kPWMTimeout = UsTime(1'000'000 / 12'500);
+    // Each new period contributes 1/2^kFilterShift of the filtered duty cycle, i.e. the filter settles in
+    // roughly 16 periods (under a millisecond at 25kHz).
+    static constexpr uint32_t kFilterShift = 4;
 
     bool capture(mcpwm_cap_channel_handle_t capChannel, const mcpwm_capture_event_data_t* eventData, void* userData);
     void timerFired(void* userData);
@@ -14,7 +16,7 @@ namespace pcp {
     FanInput::FanInput() {
         mcpwm_capture_timer_config_t captureTimerConfig = {.group_id = 1,
                                                            .clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT,
-                                                           .resolution_hz = 2'500'000,
+                                                           .resolution_hz = kCaptureResolutionHz,
                                                            .flags = {
                                                                .allow_pd = false,
                                                            }};
@@ -76,7 +78,7 @@ namespace pcp {
         if (err != ESP_OK) {
             PCP_LOGE("Error starting capture: %s", esp_err_to_name(err));
         }
-        esp_timer_start_periodic(_timer, kPWMTimeoutCheckFrequency);
+        esp_timer_start_periodic(_timer, kSaturationCheckPeriod.count());
     }
 
     void FanInput::stop(void) {
@@ -92,31 +94,67 @@ namespace pcp {
         if (_numRuns % 1000 == 0) {
             esp_timer_dump(stdout);
         }
-        return _dutyCyclePercentage;
+        return _dutyCyclePercentage.load(std::memory_order_relaxed);
+    }
+
+    size_t FanInput::drainSamples(FanInputSample* samples, size_t maxSamples) {
+        return _samples.drain(samples, maxSamples);
+    }
+
+    bool FanInput::_publishDutyCyclePercentage(uint8_t percentage, bool fromISR) {
+        if (_dutyCyclePercentage.exchange(percentage, std::memory_order_relaxed) == percentage) {
+            return false;
+        }
+
+        TaskHandle_t observer = _observerTask.load(std::memory_order_acquire);
+        if (observer == nullptr) {
+            return false;
+        }
+
+        if (fromISR) {
+            BaseType_t higherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(observer, &higherPriorityTaskWoken);
+            return higherPriorityTaskWoken == pdTRUE;
+        }
+        xTaskNotifyGive(observer);
+        return false;
     }
 
     bool FanInput::_capture(mcpwm_cap_channel_handle_t captureChannel, const mcpwm_capture_event_data_t* eventData) {
+        bool higherPriorityTaskWoken = false;
         switch (eventData->cap_edge) {
             case mcpwm_capture_edge_t::MCPWM_CAP_EDGE_NEG: _lastDescendingValue = eventData->cap_value; break;
             case mcpwm_capture_edge_t::MCPWM_CAP_EDGE_POS:
                 if (_lastAscendingValue != std::numeric_limits<uint32_t>::max() && _lastDescendingValue != std::numeric_limits<uint32_t>::max() &&
                     _lastDescendingValue > _lastAscendingValue) {
-                    const uint32_t totalTime = eventData->cap_value - _lastAscendingValue;
-                    const uint32_t onTime = _lastDescendingValue - _lastAscendingValue;
-                    _dutyCyclePercentage = (onTime * 100) / totalTime;
+                    const FanInputSample sample = {
+                        .period = eventData->cap_value - _lastAscendingValue,
+                        .onTime = _lastDescendingValue - _lastAscendingValue,
+                        .captureTicks = eventData->cap_value,
+                    };
+                    _samples.push(sample);
+
+                    const int32_t target = static_cast<int32_t>(sample.dutyCyclePercentage()) << 8;
+                    const int32_t filtered = static_cast<int32_t>(_filteredDutyCycle);
+                    _filteredDutyCycle = static_cast<uint32_t>(filtered + ((target - filtered) >> kFilterShift));
+                    higherPriorityTaskWoken = _publishDutyCyclePercentage(static_cast<uint8_t>((_filteredDutyCycle + 128) >> 8), true);
                 }
                 _lastAscendingValue = eventData->cap_value;
                 break;
         }
-        _lastCapture = esp_timer_get_time();
-        return false;
+        const WrappingUsTimestamp now = wrappingUsTimestamp(EspTimerClock::now());
+        _lastCaptureTime.store(now, std::memory_order_relaxed);
+        _lastInputTime.store(now, std::memory_order_relaxed);
+        return higherPriorityTaskWoken;
     }
 
     void FanInput::_timerFired() {
         _numRuns++;
-        if (esp_timer_get_time() > _lastCapture + kPWMTimeout) {
+        const WrappingUsTimestamp now = wrappingUsTimestamp(EspTimerClock::now());
+        if (wrappingUsElapsed(_lastCaptureTime.load(std::memory_order_relaxed), now) > kPWMTimeout) {
             const int level = gpio_get_level(kFanPWMInputGPIO);
-            _dutyCyclePercentage = level > 0 ? 100 : 0;
+            _publishDutyCyclePercentage(level > 0 ? 100 : 0, false);
+            _lastInputTime.store(now, std::memory_order_relaxed);
         }
     }
 
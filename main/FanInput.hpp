@@ -1,12 +1,30 @@
 #pragma once
 
+#include "Utilities/SPSCRingBuffer.hpp"
+#include "Utilities/Time.hpp"
+
 #include "driver/gpio.h"
 #include "driver/mcpwm_cap.h"
 #include "esp_timer.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <atomic>
 #include <limits>
 
 namespace pcp {
+    // One full period of the fan PWM signal, as measured by the capture timer.  All values are in capture
+    // timer ticks (see FanInput::kCaptureResolutionHz), and captureTicks is the timer value at the rising
+    // edge that ended the period.
+    struct FanInputSample {
+        uint32_t period;
+        uint32_t onTime;
+        uint32_t captureTicks;
+
+        uint8_t dutyCyclePercentage(void) const { return period == 0 ? 0 : static_cast<uint8_t>((onTime * 100) / period); }
+    };
+
     class FanInput {
     public:
         FanInput();
@@ -15,23 +33,49 @@ namespace pcp {
         void start(void);
         void stop(void);
 
+        // The filtered duty cycle of the input signal.
         uint8_t dutyCyclePercentage(void);
 
+        // When the input last produced a reading: a captured edge, or the saturation check finding the line
+        // held at 0% or 100%.  Older than kInputStaleAfter means neither the capture channel nor the check
+        // is running any more.
+        WrappingUsTimestamp lastInputTime(void) const { return _lastInputTime.load(std::memory_order_relaxed); }
+
+        // The given task is sent a task notification every time dutyCyclePercentage() changes.  Pass nullptr
+        // to stop notifications.
+        void setObserverTask(TaskHandle_t task) { _observerTask.store(task, std::memory_order_release); }
+
+        // Copies up to maxSamples of the periods captured since the last call into samples, oldest first,
+        // and returns how many were copied.  Must only be called from one task at a time.
+        size_t drainSamples(FanInputSample* samples, size_t maxSamples);
+        uint32_t droppedSamples(void) const { return _samples.overruns(); }
+
+        static constexpr uint32_t kCaptureResolutionHz = 2'500'000;
+        static constexpr UsTime kSaturationCheckPeriod = UsTime(1'000'000 / 30);
+        static constexpr UsTime kInputStaleAfter = 2 * kSaturationCheckPeriod;
+        // About 40ms of a 25kHz PWM signal, several times what builds up between FanController's drains.
+        static constexpr size_t kSampleBufferCapacity = 1024;
+
     private:
         bool _capture(mcpwm_cap_channel_handle_t captureChannel, const mcpwm_capture_event_data_t* eventData);
         void _timerFired();
-        void _sendDutyCyclePercentage(uint8_t percentage);
+        bool _publishDutyCyclePercentage(uint8_t percentage, bool fromISR);
 
         mcpwm_cap_timer_handle_t _captureTimer;
         mcpwm_cap_channel_handle_t _captureChannel;
-        uint64_t _lastCapture = 0;
+        std::atomic<WrappingUsTimestamp> _lastCaptureTime = 0;
+        std::atomic<WrappingUsTimestamp> _lastInputTime = 0;
         esp_timer_handle_t _timer;
         bool _timerStarted = false;
         uint32_t _numRuns = 0;
 
         uint32_t _lastDescendingValue = std::numeric_limits<uint32_t>::max();
         uint32_t _lastAscendingValue = std::numeric_limits<uint32_t>::max();
-        uint8_t _dutyCyclePercentage = 0;
+        // Exponential moving average of the per-period duty cycle, in 1/256ths of a percent.
+        uint32_t _filteredDutyCycle = 0;
+        std::atomic<uint8_t> _dutyCyclePercentage = 0;
+        std::atomic<TaskHandle_t> _observerTask = nullptr;
+        SPSCRingBuffer<FanInputSample, kSampleBufferCapacity> _samples;
 
         friend bool capture(mcpwm_cap_channel_handle_t cap_channel, const mcpwm_capture_event_data_t* edata, void* user_ctx);
         friend void timerFired(void* userData);
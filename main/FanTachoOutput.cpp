@@ -0,0 +1,124 @@
+#include "FanTachoOutput.hpp"
+
+#include "Log.hpp"
+#include "Pins.hpp"
+
+namespace pcp {
+    static constexpr ledc_mode_t kTachoSpeedMode = LEDC_LOW_SPEED_MODE;
+    static constexpr ledc_timer_t kTachoTimer = LEDC_TIMER_0;
+    static constexpr ledc_channel_t kTachoChannel = LEDC_CHANNEL_0;
+    // 14 bits of resolution lets the LEDC divider reach down to a few Hz from the 80MHz APB clock.
+    static constexpr ledc_timer_bit_t kTachoDutyResolution = LEDC_TIMER_14_BIT;
+    static constexpr uint32_t kTachoHalfDuty = 1u << (kTachoDutyResolution - 1);
+    static constexpr uint32_t kTachoPulsesPerRevolution = 2;
+    static constexpr uint32_t kTachoMinFrequencyHz = 5;
+    // The tacho line is pulled up by the motherboard, so "not spinning" is a released (high) output.
+    static constexpr uint32_t kTachoIdleLevel = 1;
+
+    static constexpr uint32_t tachoFrequencyForRPM(uint32_t rpm) {
+        return (rpm * kTachoPulsesPerRevolution) / 60;
+    }
+
+    FanTachoOutput::FanTachoOutput(uint32_t fullThrottleRPM) : _fullThrottleRPM(fullThrottleRPM) {
+        _configured = _setupLEDC();
+    }
+
+    FanTachoOutput::~FanTachoOutput() {
+        if (_configured) {
+            ledc_stop(kTachoSpeedMode, kTachoChannel, kTachoIdleLevel);
+        }
+    }
+
+    bool FanTachoOutput::_setupLEDC(void) {
+        esp_err_t err = ESP_OK;
+
+        ledc_timer_config_t timerConfig = {
+            .speed_mode = kTachoSpeedMode,
+            .duty_resolution = kTachoDutyResolution,
+            .timer_num = kTachoTimer,
+            .freq_hz = kTachoMinFrequencyHz,
+            .clk_cfg = LEDC_AUTO_CLK,
+            .deconfigure = false,
+        };
+        err = ledc_timer_config(&timerConfig);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error configuring tacho timer: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        ledc_channel_config_t channelConfig = {
+            .gpio_num = kFanTachoOutputGPIO,
+            .speed_mode = kTachoSpeedMode,
+            .channel = kTachoChannel,
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = kTachoTimer,
+            .duty = 0,
+            .hpoint = 0,
+            .sleep_mode = LEDC_SLEEP_MODE_NO_ALIVE_NO_PD,
+            .flags = {
+                .output_invert = false,
+            },
+        };
+        err = ledc_channel_config(&channelConfig);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error configuring tacho channel: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        err = gpio_od_enable(kFanTachoOutputGPIO);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error making tacho output open drain: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        err = ledc_stop(kTachoSpeedMode, kTachoChannel, kTachoIdleLevel);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error idling tacho output: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        return true;
+    }
+
+    void FanTachoOutput::setThrottle(uint8_t percentage) {
+        setRPM((_fullThrottleRPM * percentage) / 100);
+    }
+
+    void FanTachoOutput::setRPM(uint32_t rpm) {
+        if (!_configured || rpm == _rpm) {
+            return;
+        }
+        _rpm = rpm;
+
+        esp_err_t err = ESP_OK;
+        const uint32_t frequency = tachoFrequencyForRPM(rpm);
+        if (frequency < kTachoMinFrequencyHz) {
+            if (_running) {
+                err = ledc_stop(kTachoSpeedMode, kTachoChannel, kTachoIdleLevel);
+                if (err != ESP_OK) {
+                    PCP_LOGE("Error stopping tacho output: %s", esp_err_to_name(err));
+                }
+                _running = false;
+            }
+            return;
+        }
+
+        err = ledc_set_freq(kTachoSpeedMode, kTachoTimer, frequency);
+        if (err != ESP_OK) {
+            PCP_LOGE("Error setting tacho frequency to %luHz: %s", (unsigned long)frequency, esp_err_to_name(err));
+            return;
+        }
+
+        if (!_running) {
+            err = ledc_set_duty(kTachoSpeedMode, kTachoChannel, kTachoHalfDuty);
+            if (err == ESP_OK) {
+                err = ledc_update_duty(kTachoSpeedMode, kTachoChannel);
+            }
+            if (err != ESP_OK) {
+                PCP_LOGE("Error starting tacho output: %s", esp_err_to_name(err));
+                return;
+            }
+            _running = true;
+        }
+    }
+}  // namespace pcp
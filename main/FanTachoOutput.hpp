@@ -0,0 +1,34 @@
+#pragma once
+
+#include "driver/ledc.h"
+
+#include <cstdint>
+
+namespace pcp {
+    // Emulates a PC fan's tachometer signal on kFanTachoOutputGPIO, so that printer firmware sees a spinning
+    // fan.  The signal is generated by an LEDC channel - two open drain pulses per revolution at 50% duty -
+    // so it costs no CPU per pulse.  LEDC latches a new frequency at the end of the current period, so
+    // speed changes never produce a truncated or stretched pulse.
+    class FanTachoOutput {
+    public:
+        static constexpr uint32_t kDefaultFullThrottleRPM = 5000;
+
+        FanTachoOutput(uint32_t fullThrottleRPM = kDefaultFullThrottleRPM);
+        ~FanTachoOutput();
+
+        // Reports the given throttle, scaled so that 100% reads as fullThrottleRPM.
+        void setThrottle(uint8_t percentage);
+        // Reports a measured speed.
+        void setRPM(uint32_t rpm);
+
+        uint32_t rpm(void) const { return _rpm; }
+
+    private:
+        bool _setupLEDC(void);
+
+        uint32_t _fullThrottleRPM;
+        uint32_t _rpm = 0;
+        bool _running = false;
+        bool _configured = false;
+    };
+}  // namespace pcp
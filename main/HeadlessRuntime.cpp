@@ -0,0 +1,45 @@
+#include "HeadlessRuntime.hpp"
+
+#include "Log.hpp"
+#include "Utilities/Time.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace pcp {
+    static constexpr MsTime kStatusInterval = 1000_ms;
+
+    HeadlessRuntime::HeadlessRuntime() : _fanInput(), _esc(), _tachoOutput(), _fanController(_fanInput, _esc) {
+        _fanController.setTachoOutput(&_tachoOutput);
+    }
+
+    HeadlessRuntime::~HeadlessRuntime() {
+        _fanController.stop();
+        _fanInput.stop();
+    }
+
+    void HeadlessRuntime::run(void) {
+        PCP_LOGI("Starting headless fan control");
+
+        _fanInput.start();
+        _fanController.start();
+        _esc.arm([this]() { _fanController.refresh(); });
+
+        while (true) {
+            vTaskDelay(ticksToWait(kStatusInterval));
+            _logStatus();
+        }
+    }
+
+    void HeadlessRuntime::_logStatus(void) {
+        const std::optional<uint8_t> setpoint = _fanController.setpoint();
+        const std::optional<uint32_t> rpm = _esc.rpm();
+        const FailsafeWatchdog& watchdog = _fanController.watchdog();
+        PCP_LOGI("ESC: %s, fan input: %u%%, setpoint: %s, measured: %s, tacho: %lurpm, dropped samples: %lu, failsafe: %s, trips: %lu, worst gap: %lldus",
+                 _esc.stateString().c_str(), _fanInput.dutyCyclePercentage(),
+                 setpoint.has_value() ? (std::to_string(setpoint.value()) + "%").c_str() : "none",
+                 rpm.has_value() ? (std::to_string(rpm.value()) + "rpm").c_str() : "n/a", (unsigned long)_tachoOutput.rpm(),
+                 (unsigned long)_fanInput.droppedSamples(), watchdog.tripped() ? "tripped" : "ok", (unsigned long)watchdog.tripCount(),
+                 (long long)watchdog.worstGap().count());
+    }
+}  // namespace pcp
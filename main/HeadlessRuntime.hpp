@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ESC/BLHeli/BLHeliESC.hpp"
+#include "FanController.hpp"
+#include "FanInput.hpp"
+#include "FanTachoOutput.hpp"
+
+namespace pcp {
+    // Runs the fan-to-ESC control loop without a display.  The ESC is armed at boot and then follows the
+    // fan input; status is reported periodically on the serial console.
+    class HeadlessRuntime {
+    public:
+        HeadlessRuntime();
+        ~HeadlessRuntime();
+
+        void run(void);
+
+    private:
+        void _logStatus(void);
+
+        FanInput _fanInput;
+        BLHeliESC _esc;
+        FanTachoOutput _tachoOutput;
+        FanController _fanController;
+    };
+}  // namespace pcp
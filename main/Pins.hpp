@@ -3,7 +3,11 @@
 #include "driver/gpio.h"
 #include "driver/uart.h"
 
+#include "sdkconfig.h"
+
+#if !CONFIG_PCP_HW_GENERIC
 #include "bsp/esp-bsp.h"
+#endif
 #include "esp_mac.h"
 
 namespace pcp {
@@ -9,6 +9,7 @@ namespace pcp {
     FanControlUI::FanControlUI() : TestUI() {}
 
     FanControlUI::~FanControlUI() {
+        _fanController = nullptr;
         if (_fanInput != nullptr) {
             _fanInput->stop();
         }
@@ -46,7 +47,11 @@ namespace pcp {
 
     void FanControlUI::_setupMotor(void) {
         _motor = std::make_unique<BLHeliESC>();
-        _motor->arm();
+        _motor->arm([this]() {
+            if (_fanController != nullptr) {
+                _fanController->refresh();
+            }
+        });
     }
 
     void FanControlUI::_setupFanInput(void) {
@@ -54,14 +59,24 @@ namespace pcp {
         _fanInput->start();
     }
 
+    void FanControlUI::_setupFanController(void) {
+        _tachoOutput = std::make_unique<FanTachoOutput>();
+        _fanController = std::make_unique<FanController>(*_fanInput, *_motor);
+        _fanController->setTachoOutput(_tachoOutput.get());
+        _fanController->start();
+    }
+
     void FanControlUI::uiWillBecomeActive(void) {}
 
     void FanControlUI::uiDidBecomeActive(void) {
-        _setupMotor();
         _setupFanInput();
+        _setupMotor();
+        _setupFanController();
     }
 
     void FanControlUI::uiWillBecomeInactive(void) {
+        _fanController = nullptr;
+        _tachoOutput = nullptr;
         _motor->disarm();
         _motor = nullptr;
         _fanInput->stop();
@@ -70,15 +85,6 @@ namespace pcp {
 
     void FanControlUI::uiDidBecomeInactive(void) {}
 
-    void FanControlUI::uiWillUpdate(void) {
-        assert(_motor != nullptr);
-        assert(_fanInput != nullptr);
-
-        if (_motor->isArmed()) {
-            _motor->setThrottle(_fanInput->dutyCyclePercentage());
-        }
-    }
-
     void FanControlUI::updateUI(void) {
         if (_motor == nullptr) {
             assert(false && "Update UI called with no motor connection established.");
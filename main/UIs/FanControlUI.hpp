@@ -1,7 +1,9 @@
 #pragma once
 
 #include "ESC/BLHeli/BLHeliESC.hpp"
+#include "FanController.hpp"
 #include "FanInput.hpp"
+#include "FanTachoOutput.hpp"
 #include "TestUI.hpp"
 
 #include "lvgl.h"
@@ -26,7 +28,6 @@ namespace pcp {
         virtual void uiWillBecomeInactive(void) override;
         virtual void uiDidBecomeInactive(void) override;
 
-        virtual void uiWillUpdate(void) override;
         virtual void updateUI(void) override;
 
         virtual const std::string& name(void) const { return _name; }
@@ -38,6 +39,7 @@ namespace pcp {
 
         void _setupMotor(void);
         void _setupFanInput(void);
+        void _setupFanController(void);
 
         std::string _throttleText(void) const;
         void _loop(void);
@@ -48,6 +50,8 @@ namespace pcp {
 
         std::unique_ptr<BLHeliESC> _motor;
         std::unique_ptr<FanInput> _fanInput = nullptr;
+        std::unique_ptr<FanTachoOutput> _tachoOutput = nullptr;
+        std::unique_ptr<FanController> _fanController = nullptr;
 
         const std::string _name = "Fan Control";
     };
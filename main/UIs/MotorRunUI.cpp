@@ -1,5 +1,6 @@
 #include "MotorRunUI.hpp"
 
+#include "ESC/ESCAwaitables.hpp"
 #include "Log.hpp"
 
 #if defined(BSP_CAPS_BUTTONS) && BSP_CAPS_BUTTONS
@@ -39,60 +40,53 @@ namespace pcp {
         bsp_display_unlock();
 
         assert(_motor != nullptr);
-
-        if (_motor->isArmed()) {
-            _motor->disarm([this](void) { this->_disarmCompleted(); });
-        } else {
-            _motor->arm([this](void) { this->_armCompleted(); });
-        }
+        _sequencePoolAllocations = coroutineFramePool.poolAllocations();
+        _sequenceHeapAllocations = coroutineFramePool.heapAllocations();
+        _sequenceResumes = _executor.resumes();
+        spawn(_executor, _armStop());
     }
 
     void MotorRunUI::downPressed() {
         assert(_motor != nullptr);
-        _motor->decreaseThrottle(10, 250);
+        _motor->decreaseThrottle(10, 250_ms);
     }
 
     void MotorRunUI::upPressed() {
         assert(_motor != nullptr);
-        _motor->increaseThrottle(10, 250);
+        _motor->increaseThrottle(10, 250_ms);
     }
 
-    void MotorRunUI::_armCompleted(void) {
-        std::lock_guard<std::mutex> _guard(_queuedActionsMutex);
-        _queuedActions.push([this]() {
-            bsp_display_lock(0);
-            for (size_t i = 0; i < lv_obj_get_child_cnt(_armStopButton); i++) {
-                lv_obj_t* child = lv_obj_get_child(_armStopButton, i);
-                if (lv_obj_has_class(child, &lv_label_class)) {
-                    lv_label_set_text(child, LV_SYMBOL_PAUSE);
-                    break;
-                }
+    Async<void> MotorRunUI::_armStop(void) {
+        const bool arming = !_motor->isArmed();
+        if (arming) {
+            co_await armAsync(*_motor, _executor);
+        } else {
+            co_await disarmAsync(*_motor, _executor);
+        }
+
+        bsp_display_lock(0);
+        for (size_t i = 0; i < lv_obj_get_child_cnt(_armStopButton); i++) {
+            lv_obj_t* child = lv_obj_get_child(_armStopButton, i);
+            if (lv_obj_has_class(child, &lv_label_class)) {
+                lv_label_set_text(child, arming ? LV_SYMBOL_PAUSE : LV_SYMBOL_PLAY);
+                break;
             }
-            lv_obj_remove_flag(_armStopButton, LV_OBJ_FLAG_HIDDEN);
+        }
+        lv_obj_remove_flag(_armStopButton, LV_OBJ_FLAG_HIDDEN);
+        if (arming) {
             lv_obj_remove_flag(_downButton, LV_OBJ_FLAG_HIDDEN);
             lv_obj_remove_flag(_upButton, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_add_flag(_spinner, LV_OBJ_FLAG_HIDDEN);
-            bsp_display_unlock();
-        });
-    }
-
-    void MotorRunUI::_disarmCompleted(void) {
-        std::lock_guard<std::mutex> _guard(_queuedActionsMutex);
-        _queuedActions.push([this]() {
-            bsp_display_lock(0);
-            for (size_t i = 0; i < lv_obj_get_child_cnt(_armStopButton); i++) {
-                lv_obj_t* child = lv_obj_get_child(_armStopButton, i);
-                if (lv_obj_has_class(child, &lv_label_class)) {
-                    lv_label_set_text(child, LV_SYMBOL_PLAY);
-                    break;
-                }
-            }
-            lv_obj_remove_flag(_armStopButton, LV_OBJ_FLAG_HIDDEN);
+        } else {
             lv_obj_add_flag(_downButton, LV_OBJ_FLAG_HIDDEN);
             lv_obj_add_flag(_upButton, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_add_flag(_spinner, LV_OBJ_FLAG_HIDDEN);
-            bsp_display_unlock();
-        });
+        }
+        lv_obj_add_flag(_spinner, LV_OBJ_FLAG_HIDDEN);
+        bsp_display_unlock();
+
+        // Everything since the spawn, frames for the spawn and this coroutine included.
+        PCP_LOGI("%s took %lu pooled coroutine frames, %lu heap frames and %lu resumes", arming ? "Arming" : "Disarming",
+                 (unsigned long)(coroutineFramePool.poolAllocations() - _sequencePoolAllocations),
+                 (unsigned long)(coroutineFramePool.heapAllocations() - _sequenceHeapAllocations), (unsigned long)(_executor.resumes() - _sequenceResumes));
     }
 
     void MotorRunUI::deleteRootWidget(void) {
@@ -206,14 +200,7 @@ namespace pcp {
     void MotorRunUI::uiWillUpdate(void) {
         assert(_motor != nullptr);
 
-        {
-            std::lock_guard<std::mutex> locker(_queuedActionsMutex);
-            while (!_queuedActions.empty()) {
-                const std::function<void(void)>& action = _queuedActions.front();
-                _queuedActions.pop();
-                action();
-            }
-        }
+        _executor.runPending();
     }
 
     void MotorRunUI::updateUI(void) {
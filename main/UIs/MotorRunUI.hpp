@@ -3,6 +3,7 @@
 #include "ESC/BLHeli/BLHeliESC.hpp"
 #include "FanInput.hpp"
 #include "TestUI.hpp"
+#include "Utilities/Async.hpp"
 
 #include "lvgl.h"
 
@@ -10,9 +11,6 @@
 #include "iot_button.h"
 #endif
 
-#include <mutex>
-#include <queue>
-
 using mcpwm_cmpr_handle_t = struct mcpwm_cmpr_t*;
 
 namespace pcp {
@@ -51,8 +49,7 @@ namespace pcp {
         std::string _throttleText(void) const;
         void _loop(void);
 
-        void _armCompleted(void);
-        void _disarmCompleted(void);
+        Async<void> _armStop(void);
 
         lv_obj_t* _throttleLabel = nullptr;
         lv_obj_t* _downButton = nullptr;
@@ -65,8 +62,12 @@ namespace pcp {
         button_handle_t _rightButton = nullptr;
 #endif
 
-        std::mutex _queuedActionsMutex;
-        std::queue<std::function<void(void)>> _queuedActions;
+        // Drained from uiWillUpdate, so coroutines spawned here carry on on the UI task.
+        CoroutineExecutor _executor;
+        // The frame pool and executor counters when the current arm/stop sequence was spawned.
+        uint32_t _sequencePoolAllocations = 0;
+        uint32_t _sequenceHeapAllocations = 0;
+        uint32_t _sequenceResumes = 0;
 
         std::unique_ptr<BLHeliESC> _motor = nullptr;
 
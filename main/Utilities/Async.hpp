@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Utilities/CoroutineExecutor.hpp"
+#include "Utilities/FramePool.hpp"
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace pcp {
+    // Every coroutine frame here comes from one pool, sized for the handful of sequences that are ever in
+    // flight at once.  A frame is the coroutine's locals plus whatever it's awaiting.
+    static constexpr size_t kCoroutineFrameSize = 512;
+    static constexpr size_t kCoroutineFrameCount = 8;
+
+    using CoroutineFramePool = FramePool<kCoroutineFrameSize, kCoroutineFrameCount>;
+    inline CoroutineFramePool coroutineFramePool;
+
+    struct PooledCoroutineFrame {
+        static void* operator new(size_t size) { return coroutineFramePool.allocate(size); }
+        static void operator delete(void* pointer) { coroutineFramePool.deallocate(pointer); }
+    };
+
+    template <typename T>
+    class Async;
+
+    struct AsyncPromiseBase : public PooledCoroutineFrame {
+        struct FinalAwaiter {
+            bool await_ready(void) const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                return handle.promise().continuation;
+            }
+
+            void await_resume(void) const noexcept {}
+        };
+
+        std::suspend_always initial_suspend(void) const noexcept { return {}; }
+        FinalAwaiter final_suspend(void) const noexcept { return {}; }
+        void unhandled_exception(void) { assert(false && "Coroutines don't throw"); }
+
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+    };
+
+    template <typename T>
+    struct AsyncPromise : public AsyncPromiseBase {
+        Async<T> get_return_object(void);
+        void return_value(T result) { value.emplace(std::move(result)); }
+
+        std::optional<T> value;
+    };
+
+    template <>
+    struct AsyncPromise<void> : public AsyncPromiseBase {
+        Async<void> get_return_object(void);
+        void return_void(void) {}
+    };
+
+    // A coroutine that does nothing until it's awaited, then runs on the awaiting coroutine's task and
+    // carries straight on with it when it finishes.  To start one with nothing awaiting it, spawn() it.
+    template <typename T = void>
+    class [[nodiscard]] Async {
+    public:
+        using promise_type = AsyncPromise<T>;
+
+        explicit Async(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+        Async(Async&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+        Async(const Async&) = delete;
+        Async& operator=(const Async&) = delete;
+
+        ~Async() {
+            if (_handle) {
+                _handle.destroy();
+            }
+        }
+
+        bool await_ready(void) const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            _handle.promise().continuation = awaiting;
+            return _handle;
+        }
+
+        T await_resume(void) {
+            if constexpr (!std::is_void_v<T>) {
+                return std::move(_handle.promise().value.value());
+            }
+        }
+
+    private:
+        std::coroutine_handle<promise_type> _handle;
+    };
+
+    template <typename T>
+    Async<T> AsyncPromise<T>::get_return_object(void) {
+        return Async<T>(std::coroutine_handle<AsyncPromise<T>>::from_promise(*this));
+    }
+
+    inline Async<void> AsyncPromise<void>::get_return_object(void) {
+        return Async<void>(std::coroutine_handle<AsyncPromise<void>>::from_promise(*this));
+    }
+
+    // The root of a spawned coroutine, which frees its own frame when it finishes.
+    struct DetachedAsync {
+        struct promise_type : public PooledCoroutineFrame {
+            DetachedAsync get_return_object(void) const { return {}; }
+            std::suspend_never initial_suspend(void) const noexcept { return {}; }
+            std::suspend_never final_suspend(void) const noexcept { return {}; }
+            void return_void(void) const {}
+            void unhandled_exception(void) { assert(false && "Coroutines don't throw"); }
+        };
+    };
+
+    // Runs async on the executor, with nothing waiting for it to finish.
+    inline DetachedAsync spawn(CoroutineExecutor& executor, Async<void> async) {
+        co_await executor.schedule();
+        co_await async;
+    }
+
+    // Awaits something that reports back through a completion callback.  start is handed this awaitable
+    // once the coroutine has suspended, and must see that complete() is called exactly once, from any
+    // task.  The coroutine is then resumed on the executor, never inline from complete().  A completion
+    // that only captures the awaitable's address fits inside std::function, so doesn't allocate.
+    template <typename T, typename Start>
+    class CompletionAwaitable {
+    public:
+        CompletionAwaitable(CoroutineExecutor& executor, Start start) : _executor(executor), _start(std::move(start)) {}
+
+        bool await_ready(void) const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            _handle = handle;
+            _start(this);
+        }
+
+        T await_resume(void) { return std::move(_result.value()); }
+
+        // Nothing of the awaitable is touched once the coroutine's been posted, as it may already be gone.
+        void complete(T result) {
+            _result.emplace(std::move(result));
+            _executor.post(_handle);
+        }
+
+    private:
+        CoroutineExecutor& _executor;
+        Start _start;
+        std::coroutine_handle<> _handle;
+        std::optional<T> _result;
+    };
+
+    template <typename T, typename Start>
+    CompletionAwaitable<T, Start> awaitCompletion(CoroutineExecutor& executor, Start start) {
+        return CompletionAwaitable<T, Start>(executor, std::move(start));
+    }
+}  // namespace pcp
@@ -0,0 +1,69 @@
+#include "Utilities/CoroutineExecutor.hpp"
+
+#include "Log.hpp"
+#include "Utilities/freeRTOSErrorString.hpp"
+
+namespace pcp {
+    void coroutineExecutorTask(void* userInfo);
+
+    CoroutineExecutor::CoroutineExecutor(size_t capacity) {
+        _queue = xQueueCreate(capacity, sizeof(void*));
+        if (_queue == nullptr) {
+            PCP_LOGE("Coroutine executor queue creation failed");
+        }
+    }
+
+    CoroutineExecutor::~CoroutineExecutor() {
+        if (_executorTask != nullptr) {
+            vTaskDelete(_executorTask);
+        }
+        if (_queue != nullptr) {
+            vQueueDelete(_queue);
+        }
+    }
+
+    bool CoroutineExecutor::startTask(const char* name, uint32_t stackSize, UBaseType_t priority) {
+        assert(_executorTask == nullptr);
+        BaseType_t err = xTaskCreate(coroutineExecutorTask, name, stackSize, this, priority, &_executorTask);
+        if (err != pdPASS) {
+            PCP_LOGE("Coroutine executor task creation failed: %s", freeRTOSErrorString(err));
+            _executorTask = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    size_t CoroutineExecutor::runPending(void) {
+        size_t resumed = 0;
+        void* address = nullptr;
+        while (xQueueReceive(_queue, &address, 0) == pdTRUE) {
+            _resume(address);
+            resumed++;
+        }
+        return resumed;
+    }
+
+    void CoroutineExecutor::post(std::coroutine_handle<> handle) {
+        void* address = handle.address();
+        while (xQueueSend(_queue, &address, portMAX_DELAY) != pdTRUE) {}
+    }
+
+    void CoroutineExecutor::_task(void) {
+        void* address = nullptr;
+        while (true) {
+            if (xQueueReceive(_queue, &address, portMAX_DELAY) == pdTRUE) {
+                _resume(address);
+            }
+        }
+    }
+
+    void CoroutineExecutor::_resume(void* address) {
+        _resumes.fetch_add(1, std::memory_order_relaxed);
+        std::coroutine_handle<>::from_address(address).resume();
+    }
+
+    void coroutineExecutorTask(void* userInfo) {
+        CoroutineExecutor* executor = reinterpret_cast<CoroutineExecutor*>(userInfo);
+        executor->_task();
+    }
+}  // namespace pcp
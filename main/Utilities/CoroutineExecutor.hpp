@@ -0,0 +1,55 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+namespace pcp {
+    // Resumes coroutines from a FreeRTOS queue of their handles.  Handles can be posted from any task, and
+    // the coroutines carry on either on a task of the executor's own or on whichever task calls
+    // runPending(), e.g. once per UI frame.  Posting never allocates.
+    class CoroutineExecutor {
+    public:
+        static constexpr size_t kDefaultCapacity = 16;
+
+        explicit CoroutineExecutor(size_t capacity = kDefaultCapacity);
+        ~CoroutineExecutor();
+
+        bool startTask(const char* name, uint32_t stackSize = 4096, UBaseType_t priority = 5);
+
+        // Resumes everything posted so far, returning how many were.
+        size_t runPending(void);
+
+        // Blocks while the queue's full rather than lose a coroutine.
+        void post(std::coroutine_handle<> handle);
+
+        // co_await executor.schedule() carries on on the executor.
+        auto schedule(void) {
+            struct Schedule {
+                CoroutineExecutor& executor;
+
+                bool await_ready(void) const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+                void await_resume(void) const noexcept {}
+            };
+            return Schedule{*this};
+        }
+
+        uint32_t resumes(void) const { return _resumes.load(std::memory_order_relaxed); }
+
+    private:
+        void _task(void);
+        void _resume(void* address);
+
+        friend void coroutineExecutorTask(void* userInfo);
+
+        QueueHandle_t _queue = nullptr;
+        TaskHandle_t _executorTask = nullptr;
+        std::atomic<uint32_t> _resumes = 0;
+    };
+}  // namespace pcp
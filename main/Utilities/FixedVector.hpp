@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+
+namespace pcp {
+    // A vector with its storage inline, so it never touches the heap and can be built in a constexpr
+    // context.  Elements past size() are default constructed placeholders.
+    template <typename T, size_t capacity>
+    class FixedVector {
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        constexpr FixedVector() {}
+
+        constexpr FixedVector(std::initializer_list<T> elements) {
+            assert(elements.size() <= capacity && "FixedVector initialised with too many elements");
+            for (const T& element : elements) {
+                push_back(element);
+            }
+        }
+
+        constexpr bool push_back(const T& element) {
+            if (full()) {
+                return false;
+            }
+            _elements[_size++] = element;
+            return true;
+        }
+
+        constexpr bool push_back(T&& element) {
+            if (full()) {
+                return false;
+            }
+            _elements[_size++] = std::move(element);
+            return true;
+        }
+
+        // Shuffles the remaining elements down, which is fine for the handful we keep in one of these.
+        constexpr void pop_front(void) {
+            assert(!empty());
+            for (size_t i = 1; i < _size; ++i) {
+                _elements[i - 1] = std::move(_elements[i]);
+            }
+            _elements[--_size] = T();
+        }
+
+        constexpr void pop_back(void) {
+            assert(!empty());
+            _elements[--_size] = T();
+        }
+
+        constexpr void clear(void) {
+            while (_size > 0) {
+                _elements[--_size] = T();
+            }
+        }
+
+        constexpr size_t size(void) const { return _size; }
+        static constexpr size_t max_size(void) { return capacity; }
+        constexpr bool empty(void) const { return _size == 0; }
+        constexpr bool full(void) const { return _size == capacity; }
+
+        constexpr T& operator[](size_t index) { return _elements[index]; }
+        constexpr const T& operator[](size_t index) const { return _elements[index]; }
+
+        constexpr T& front(void) { return _elements[0]; }
+        constexpr const T& front(void) const { return _elements[0]; }
+        constexpr T& back(void) { return _elements[_size - 1]; }
+        constexpr const T& back(void) const { return _elements[_size - 1]; }
+
+        constexpr iterator begin(void) { return _elements.data(); }
+        constexpr const_iterator begin(void) const { return _elements.data(); }
+        constexpr iterator end(void) { return _elements.data() + _size; }
+        constexpr const_iterator end(void) const { return _elements.data() + _size; }
+
+        constexpr reverse_iterator rbegin(void) { return reverse_iterator(end()); }
+        constexpr const_reverse_iterator rbegin(void) const { return const_reverse_iterator(end()); }
+        constexpr reverse_iterator rend(void) { return reverse_iterator(begin()); }
+        constexpr const_reverse_iterator rend(void) const { return const_reverse_iterator(begin()); }
+
+    private:
+        std::array<T, capacity> _elements{};
+        size_t _size = 0;
+    };
+}  // namespace pcp
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace pcp {
+    // Fixed size blocks handed out from static storage, for coroutine frames.  Taking and returning a block
+    // is a compare-and-swap on a bitmap, so it's safe from any task.  Anything too big, or asked for while
+    // every block is in use, falls back to the heap and is counted, so the sizes can be tuned.
+    template <size_t blockSize, size_t blockCount>
+    class FramePool {
+    public:
+        static_assert(blockCount > 0 && blockCount <= 32, "Free blocks are tracked in a 32 bit bitmap");
+        static_assert(blockSize % alignof(std::max_align_t) == 0, "Blocks must stay aligned for any frame");
+
+        void* allocate(size_t size) {
+            if (size <= blockSize) {
+                uint32_t free = _freeBlocks.load(std::memory_order_relaxed);
+                while (free != 0) {
+                    const uint32_t block = free & (~free + 1);
+                    if (_freeBlocks.compare_exchange_weak(free, free & ~block, std::memory_order_acquire, std::memory_order_relaxed)) {
+                        _poolAllocations.fetch_add(1, std::memory_order_relaxed);
+                        return _blocks[__builtin_ctz(block)].data();
+                    }
+                }
+            }
+
+            _heapAllocations.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+
+        void deallocate(void* pointer) {
+            const std::byte* bytes = static_cast<const std::byte*>(pointer);
+            const std::byte* first = _blocks.front().data();
+            if (bytes < first || bytes >= first + blockSize * blockCount) {
+                ::operator delete(pointer);
+                return;
+            }
+
+            const size_t index = static_cast<size_t>(bytes - first) / blockSize;
+            _freeBlocks.fetch_or(uint32_t(1) << index, std::memory_order_release);
+        }
+
+        uint32_t poolAllocations(void) const { return _poolAllocations.load(std::memory_order_relaxed); }
+        uint32_t heapAllocations(void) const { return _heapAllocations.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr uint32_t kAllBlocks = blockCount == 32 ? 0xffffffffu : (uint32_t(1) << blockCount) - 1;
+
+        alignas(std::max_align_t) std::array<std::array<std::byte, blockSize>, blockCount> _blocks;
+        std::atomic<uint32_t> _freeBlocks = kAllBlocks;
+        std::atomic<uint32_t> _poolAllocations = 0;
+        std::atomic<uint32_t> _heapAllocations = 0;
+    };
+}  // namespace pcp
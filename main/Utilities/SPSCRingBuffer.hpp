@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace pcp {
+    // A fixed capacity, lock free ring buffer with exactly one producer and one consumer.  The producer
+    // may be an ISR - push() neither allocates nor blocks.  When the buffer is full new elements are
+    // dropped (and counted) rather than overwriting ones the consumer may be reading.
+    template <typename T, size_t capacity>
+    class SPSCRingBuffer {
+        static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "SPSCRingBuffer capacity must be a power of two");
+
+    public:
+        bool push(const T& element) {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            const size_t tail = _tail.load(std::memory_order_acquire);
+            if (head - tail == capacity) {
+                _overruns.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _elements[head & kIndexMask] = element;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& outElement) { return drain(&outElement, 1) == 1; }
+
+        size_t drain(T* outElements, size_t maxElements) {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            const size_t head = _head.load(std::memory_order_acquire);
+            const size_t available = head - tail;
+            const size_t count = available < maxElements ? available : maxElements;
+            for (size_t i = 0; i < count; ++i) {
+                outElements[i] = _elements[(tail + i) & kIndexMask];
+            }
+            _tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        size_t size(void) const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+        bool empty(void) const { return size() == 0; }
+
+        uint32_t overruns(void) const { return _overruns.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr size_t kIndexMask = capacity - 1;
+
+        std::array<T, capacity> _elements{};
+        std::atomic<size_t> _head = 0;
+        std::atomic<size_t> _tail = 0;
+        std::atomic<uint32_t> _overruns = 0;
+    };
+}  // namespace pcp
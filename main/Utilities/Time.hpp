@@ -0,0 +1,86 @@
+#pragma once
+
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <ratio>
+
+namespace pcp {
+    // Strongly typed durations.  Conversions that can't lose anything (e.g. milliseconds to microseconds) are
+    // implicit, anything that might truncate has to be spelt out, either with std::chrono::duration_cast (which
+    // rounds towards zero) or with checkedDurationCast (which asserts nothing was lost).
+    using UsTime = std::chrono::duration<int64_t, std::micro>;
+    using MsTime = std::chrono::duration<int32_t, std::milli>;
+    using NsTime = std::chrono::duration<int64_t, std::nano>;
+
+    // FreeRTOS scheduler ticks.
+    using RTOSTicks = std::chrono::duration<TickType_t, std::ratio<1, configTICK_RATE_HZ>>;
+
+    // Ticks of a hardware timer (MCPWM, RMT, ...) running at resolutionHz.
+    template <uint32_t resolutionHz>
+    using TimerTicks = std::chrono::duration<uint32_t, std::ratio<1, resolutionHz>>;
+
+    // Converts between durations, asserting that the value survives the trip unchanged, i.e. that it neither
+    // overflowed the destination nor had a fractional part truncated.  In a constant expression a failure is
+    // a compile error.
+    template <typename To, typename Rep, typename Period>
+    constexpr To checkedDurationCast(std::chrono::duration<Rep, Period> from) {
+        const To to = std::chrono::duration_cast<To>(from);
+        assert((std::chrono::duration_cast<std::chrono::duration<Rep, Period>>(to) == from) && "Duration conversion lost precision");
+        assert((from.count() < 0) == (to.count() < 0) && "Duration conversion overflowed");
+        return to;
+    }
+
+    // The number of scheduler ticks to wait for at least duration, rounding up so timeouts are never short.
+    template <typename Rep, typename Period>
+    constexpr TickType_t ticksToWait(std::chrono::duration<Rep, Period> duration) {
+        if (duration <= duration.zero()) {
+            return 0;
+        }
+        const auto ticks = std::chrono::ceil<RTOSTicks>(duration);
+        return ticks.count() >= portMAX_DELAY ? portMAX_DELAY - 1 : ticks.count();
+    }
+
+    // A monotonic clock backed by esp_timer, counting microseconds since boot.
+    struct EspTimerClock {
+        using duration = UsTime;
+        using rep = duration::rep;
+        using period = duration::period;
+        using time_point = std::chrono::time_point<EspTimerClock>;
+        static constexpr bool is_steady = true;
+
+        static time_point now(void) { return time_point(UsTime(esp_timer_get_time())); }
+    };
+
+    // The low 32 bits of an EspTimerClock time, small enough to keep in a lock free atomic.  Differences
+    // between two of these are correct as long as they're within ~71 minutes of one another.
+    using WrappingUsTimestamp = uint32_t;
+
+    inline WrappingUsTimestamp wrappingUsTimestamp(EspTimerClock::time_point time) {
+        return static_cast<WrappingUsTimestamp>(time.time_since_epoch().count());
+    }
+
+    constexpr UsTime wrappingUsElapsed(WrappingUsTimestamp from, WrappingUsTimestamp to) {
+        return UsTime(static_cast<WrappingUsTimestamp>(to - from));
+    }
+
+    constexpr UsTime operator""_us(unsigned long long t) {
+        return UsTime(static_cast<int64_t>(t));
+    }
+
+    constexpr MsTime operator""_ms(unsigned long long t) {
+        return MsTime(static_cast<int32_t>(t));
+    }
+
+    constexpr MsTime operator""_s(unsigned long long t) {
+        return MsTime(static_cast<int32_t>(t) * 1000);
+    }
+
+    static_assert(checkedDurationCast<UsTime>(3_ms) == 3000_us);
+    static_assert(std::chrono::duration_cast<MsTime>(1500_us) == 1_ms);
+}  // namespace pcp
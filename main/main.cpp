@@ -1,19 +1,41 @@
-#include "UIs/RootUI.hpp"
+#include "sdkconfig.h"
+
+#include "Log.hpp"
 
 #include "esp_timer.h"
+#include "nvs_flash.h"
+
+#if CONFIG_PCP_HEADLESS
+#include "HeadlessRuntime.hpp"
+#else
+#include "UIs/RootUI.hpp"
 
 #if defined(BSP_CAPS_DISPLAY) && BSP_CAPS_DISPLAY
 #define USER_INTERFACE 1
 #endif
+#endif
 
 void init(void) {
     // esp_timer_init();
+
+    // Holds the ESC's cached throttle endpoints.  A partition from an older layout is wiped and rebuilt.
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if (err != ESP_OK) {
+        PCP_LOGE("Error initialising NVS: %s", esp_err_to_name(err));
+    }
 }
 
 extern "C" void app_main(void) {
     init();
 
-#if USER_INTERFACE
+#if CONFIG_PCP_HEADLESS
+    pcp::HeadlessRuntime runtime;
+    runtime.run();
+#elif USER_INTERFACE
     pcp::RootUI rootUI;
     rootUI.run();
 #endif